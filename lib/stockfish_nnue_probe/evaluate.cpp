@@ -19,6 +19,7 @@
 #include "evaluate.h"
 
 #include <algorithm>
+#include <cassert>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -38,9 +39,16 @@
 //     const unsigned char *const gEmbeddedNNUEEnd;     // a marker to the end
 //     const unsigned int         gEmbeddedNNUESize;    // the size of the embedded file
 // Note that this does not work in Microsoft Visual Studio.
+// When the library is built once per instruction set (see probe_backend.h), only
+// one copy embeds the data and the others, built with NNUE_EMBEDDING_SHARED, refer to it.
 #if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
+    #if defined(NNUE_EMBEDDING_SHARED)
+INCBIN_EXTERN(EmbeddedNNUEBig);
+INCBIN_EXTERN(EmbeddedNNUESmall);
+    #else
 INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
 INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
+    #endif
 #else
 const unsigned char        gEmbeddedNNUEBigData[1]   = {0x0};
 const unsigned char* const gEmbeddedNNUEBigEnd       = &gEmbeddedNNUEBigData[1];
@@ -56,12 +64,24 @@ namespace Stockfish {
 namespace Eval {
 
     NNUE::EvalFiles NNUE::load_networks(const std::string& rootDirectory,
-                                        NNUE::EvalFiles    evalFiles) {
+                                        NNUE::EvalFiles    evalFiles,
+                                        const std::string& blobDirectory) {
 
         for (auto& [netSize, evalFile] : evalFiles)
         {
             std::string user_eval_file = evalFile.defaultName;
 
+            // Pre-decoded copy of the net for these kernels, see NNUE::load_eval()
+            std::string blob_file =
+              blobDirectory.empty() ? ""
+                                    : blobDirectory + "/" + user_eval_file
+                                        + (netSize == Small ? ".small." : ".big.")
+                                        + NNUE::SimdName + ".blob";
+            auto load = [&](std::istream& stream) {
+                return blob_file.empty() ? NNUE::load_eval(stream, netSize)
+                                         : NNUE::load_eval(stream, netSize, blob_file);
+            };
+
 #if defined(DEFAULT_NNUE_DIRECTORY)
             std::vector<std::string> dirs = {"<internal>", "", rootDirectory,
                                          stringify(DEFAULT_NNUE_DIRECTORY)};
@@ -76,7 +96,7 @@ namespace Eval {
                     if (directory != "<internal>")
                     {
                         std::ifstream stream(directory + user_eval_file, std::ios::binary);
-                        auto          description = NNUE::load_eval(stream, netSize);
+                        auto          description = load(stream);
 
                         if (description.has_value())
                         {
@@ -94,6 +114,24 @@ namespace Eval {
                                 setg(p, p, p + n);
                                 setp(p, p + n);
                             }
+
+                        protected:
+                            // Seeking lets the blob lookup sample the data
+                            pos_type seekoff(off_type                off,
+                                             std::ios_base::seekdir  dir,
+                                             std::ios_base::openmode) override {
+                                char* base = dir == std::ios_base::beg ? eback()
+                                           : dir == std::ios_base::end ? egptr()
+                                                                       : gptr();
+                                if (base + off < eback() || base + off > egptr())
+                                    return pos_type(off_type(-1));
+                                setg(eback(), base + off, egptr());
+                                return pos_type(gptr() - eback());
+                            }
+
+                            pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+                                return seekoff(off_type(pos), std::ios_base::beg, which);
+                            }
                         };
 
                         MemoryBuffer buffer(
@@ -104,7 +142,7 @@ namespace Eval {
                         (void) gEmbeddedNNUESmallEnd;
 
                         std::istream stream(&buffer);
-                        auto         description = NNUE::load_eval(stream, netSize);
+                        auto         description = load(stream);
 
 
                         if (description.has_value())
@@ -130,15 +168,13 @@ int Eval::simple_eval(const Position& pos, Color c) {
 }
 
 
-    Value Eval::evaluate(const Position& pos) {
+namespace {
 
-        int  simpleEval = simple_eval(pos, pos.side_to_move());
-        bool smallNet   = std::abs(simpleEval) > 1050;
-
-        int nnueComplexity;
+    // Picks the small network for lopsided material, where its accuracy is sufficient
+    bool use_small_net(int simpleEval) { return std::abs(simpleEval) > 1050; }
 
-        Value nnue = smallNet ? NNUE::evaluate<NNUE::Small>(pos, true, &nnueComplexity)
-                              : NNUE::evaluate<NNUE::Big>(pos, true, &nnueComplexity);
+    // Blends the network output with the material and fifty-move counter
+    Value adjust_eval(const Position& pos, int simpleEval, Value nnue, int nnueComplexity) {
 
         nnue -= nnue * (nnueComplexity + std::abs(simpleEval - nnue)) / 32768;
 
@@ -154,4 +190,71 @@ int Eval::simple_eval(const Position& pos, Color c) {
 
         return v;
     }
+}
+
+    Value Eval::evaluate(const Position& pos, NNUE::AccumulatorCaches* caches) {
+
+        int  simpleEval = simple_eval(pos, pos.side_to_move());
+        bool smallNet   = use_small_net(simpleEval);
+
+        int nnueComplexity;
+
+        Value nnue = smallNet ? NNUE::evaluate<NNUE::Small>(pos, true, &nnueComplexity, caches)
+                              : NNUE::evaluate<NNUE::Big>(pos, true, &nnueComplexity, caches);
+
+        return adjust_eval(pos, simpleEval, nnue, nnueComplexity);
+    }
+
+    // Estimate of evaluate() from the PSQT term of the network alone, scaled the same
+    // way. Much cheaper, as the layer stack is not run, but off by the positional term.
+    Value Eval::evaluate_psqt(const Position& pos, NNUE::AccumulatorCaches* caches) {
+
+        int  simpleEval = simple_eval(pos, pos.side_to_move());
+        bool smallNet   = use_small_net(simpleEval);
+
+        Value psqt = smallNet ? NNUE::evaluate_psqt<NNUE::Small>(pos, caches)
+                              : NNUE::evaluate_psqt<NNUE::Big>(pos, caches);
+
+        return adjust_eval(pos, simpleEval, psqt, 0);
+    }
+
+    // Same as evaluate() for up to NNUE::MaxBatchSize freshly set positions, each of
+    // which goes through the batched evaluation of the network it uses.
+    void Eval::evaluate(const Position* const pos[], int count, Value out[]) {
+
+        assert(count <= NNUE::MaxBatchSize);
+
+        const Position* batch[2][NNUE::MaxBatchSize];
+        int             index[2][NNUE::MaxBatchSize], size[2] = {0, 0};
+        int             simpleEval[NNUE::MaxBatchSize];
+
+        for (int i = 0; i < count; ++i)
+        {
+            simpleEval[i] = simple_eval(*pos[i], pos[i]->side_to_move());
+
+            const int net           = use_small_net(simpleEval[i]);
+            batch[net][size[net]]   = pos[i];
+            index[net][size[net]++] = i;
+        }
+
+        for (int net = 0; net < 2; ++net)
+        {
+            if (!size[net])
+                continue;
+
+            Value nnue[NNUE::MaxBatchSize];
+            int   nnueComplexity[NNUE::MaxBatchSize];
+
+            if (net)
+                NNUE::evaluate<NNUE::Small>(batch[net], size[net], nnue, true, nnueComplexity);
+            else
+                NNUE::evaluate<NNUE::Big>(batch[net], size[net], nnue, true, nnueComplexity);
+
+            for (int j = 0; j < size[net]; ++j)
+            {
+                const int i = index[net][j];
+                out[i]      = adjust_eval(*pos[i], simpleEval[i], nnue[j], nnueComplexity[j]);
+            }
+        }
+    }
 }  // namespace Stockfish
@@ -30,8 +30,14 @@ class Position;
 
 namespace Eval {
 
+namespace NNUE {
+struct AccumulatorCaches;
+}
+
 int   simple_eval(const Position& pos, Color c);
-Value evaluate(const Position& pos);
+Value evaluate(const Position& pos, NNUE::AccumulatorCaches* caches = nullptr);
+void  evaluate(const Position* const pos[], int count, Value out[]);
+Value evaluate_psqt(const Position& pos, NNUE::AccumulatorCaches* caches = nullptr);
 
 // The default net name MUST follow the format nn-[SHA256 first 12 digits].nnue
 // for the build process (profile-build and fishtest) to work. Do not change the
@@ -56,7 +62,8 @@ enum NetSize : int;
 
 using EvalFiles = std::unordered_map<Eval::NNUE::NetSize, EvalFile>;
 
-EvalFiles load_networks(const std::string&, EvalFiles);
+// With a blobDirectory, every net is also kept there pre-decoded for faster loading
+EvalFiles load_networks(const std::string&, EvalFiles, const std::string& blobDirectory = "");
 
 }  // namespace NNUE
 
@@ -47,13 +47,17 @@ using fun8_t = bool (*)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGE
 }
 #endif
 
+#include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <string_view>
+#include <unordered_map>
 
 #include "types.h"
 
@@ -61,6 +65,13 @@ using fun8_t = bool (*)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGE
     #include <sys/mman.h>
 #endif
 
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
   || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32)) \
   || defined(__e2k__)
@@ -504,6 +515,14 @@ void* aligned_large_pages_alloc(size_t allocSize) {
 
 #else
 
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+
+// Sizes of the blocks taken from the hugetlbfs pool, which are unmapped rather than freed
+static std::mutex                              hugetlbMutex;
+static std::unordered_map<void*, std::size_t> hugetlbBlocks;
+
+    #endif
+
 void* aligned_large_pages_alloc(size_t allocSize) {
 
     #if defined(__linux__)
@@ -514,7 +533,22 @@ void* aligned_large_pages_alloc(size_t allocSize) {
 
     // Round up to multiples of alignment
     size_t size = ((allocSize + alignment - 1) / alignment) * alignment;
-    void*  mem  = std_aligned_alloc(alignment, size);
+
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+    // Explicit huge pages, only available when the administrator reserved a pool
+    // (vm.nr_hugepages). They are never split or swapped.
+    void* huge = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED)
+    {
+        std::lock_guard<std::mutex> lock(hugetlbMutex);
+        hugetlbBlocks[huge] = size;
+        return huge;
+    }
+    #endif
+
+    // Otherwise transparent huge pages, which the kernel grants as it sees fit
+    void* mem = std_aligned_alloc(alignment, size);
     #if defined(MADV_HUGEPAGE)
     madvise(mem, size, MADV_HUGEPAGE);
     #endif
@@ -541,7 +575,124 @@ void aligned_large_pages_free(void* mem) {
 
 #else
 
-void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
+void aligned_large_pages_free(void* mem) {
+
+    #if defined(__linux__) && defined(MAP_HUGETLB)
+    {
+        std::lock_guard<std::mutex> lock(hugetlbMutex);
+        auto                        block = hugetlbBlocks.find(mem);
+        if (block != hugetlbBlocks.end())
+        {
+            munmap(mem, block->second);
+            hugetlbBlocks.erase(block);
+            return;
+        }
+    }
+    #endif
+
+    std_aligned_free(mem);
+}
+
+#endif
+
+
+const char* large_pages_kind([[maybe_unused]] const void* mem) {
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    std::lock_guard<std::mutex> lock(hugetlbMutex);
+    if (hugetlbBlocks.count(const_cast<void*>(mem)))
+        return "hugetlbfs";
+    return "transparent huge pages";
+#elif defined(_WIN32)
+    return "large pages if permitted";
+#else
+    return "default pages";
+#endif
+}
+
+
+// huge_page_bytes() sums what /proc/self/smaps reports as backed by huge pages, of any
+// kind, in the mappings overlapping [mem, mem + size). Mappings partly outside the range
+// count in proportion to their overlap. Returns 0 where smaps is not available.
+
+size_t huge_page_bytes([[maybe_unused]] const void* mem, [[maybe_unused]] size_t size) {
+
+#if defined(__linux__)
+    std::ifstream smaps("/proc/self/smaps");
+    const auto    begin = reinterpret_cast<std::uintptr_t>(mem), end = begin + size;
+
+    std::string    line;
+    std::uintptr_t vmaBegin = 0, vmaEnd = 0;
+    double         bytes = 0;
+
+    while (std::getline(smaps, line))
+    {
+        unsigned long long from, to, kb;
+        char               field[64];
+
+        if (std::sscanf(line.c_str(), "%llx-%llx ", &from, &to) == 2)
+        {
+            vmaBegin = std::uintptr_t(from);
+            vmaEnd   = std::uintptr_t(to);
+        }
+        else if (vmaEnd > begin && vmaBegin < end
+                 && std::sscanf(line.c_str(), "%63[^:]: %llu kB", field, &kb) == 2)
+        {
+            const std::string_view name(field);
+            if (name == "AnonHugePages" || name == "ShmemPmdMapped" || name == "FilePmdMapped"
+                || name == "Private_Hugetlb" || name == "Shared_Hugetlb")
+            {
+                const double overlap = double(std::min(vmaEnd, end) - std::max(vmaBegin, begin));
+                bytes += kb * 1024.0 * overlap / double(vmaEnd - vmaBegin);
+            }
+        }
+    }
+    return size_t(bytes);
+#else
+    return 0;
+#endif
+}
+
+
+// map_file() maps a file read-only with pages shared between all processes mapping it.
+// Not implemented on Windows, where callers fall back to reading the file.
+
+#ifndef _WIN32
+
+const void* map_file(const std::string& path, size_t& size) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat st;
+    void*       mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        size = size_t(st.st_size);
+        mem  = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    #if defined(MADV_HUGEPAGE)
+    // Honoured for files on huge-page tmpfs or with CONFIG_READ_ONLY_THP_FOR_FS
+    if (mem != MAP_FAILED)
+        madvise(mem, size, MADV_HUGEPAGE);
+    #endif
+
+    return mem == MAP_FAILED ? nullptr : mem;
+}
+
+void unmap_file(const void* mem, size_t size) {
+    if (mem)
+        munmap(const_cast<void*>(mem), size);
+}
+
+#else
+
+const void* map_file(const std::string&, size_t&) { return nullptr; }
+
+void unmap_file(const void*, size_t) {}
 
 #endif
 
@@ -47,6 +47,13 @@ void  std_aligned_free(void* ptr);
 void* aligned_large_pages_alloc(size_t size);
 // nop if mem == nullptr
 void aligned_large_pages_free(void* mem);
+// part of [mem, mem + size) the OS actually backs with huge pages, 0 if unknown
+size_t huge_page_bytes(const void* mem, size_t size);
+// "hugetlbfs" for memory from aligned_large_pages_alloc()'s explicit huge pages
+const char* large_pages_kind(const void* mem);
+// maps a whole file read-only and shared, nullptr if that is not possible
+const void* map_file(const std::string& path, size_t& size);
+void        unmap_file(const void* mem, size_t size);
 
 void dbg_hit_on(bool cond, int slot = 0);
 void dbg_mean_of(int64_t value, int slot = 0);
@@ -102,6 +109,8 @@ class ValueList {
     void        push_back(const T& value) { values_[size_++] = value; }
     const T*    begin() const { return values_; }
     const T*    end() const { return values_ + size_; }
+    T*          begin() { return values_; }
+    T*          end() { return values_ + size_; }
     const T&    operator[](int index) const { return values_[index]; }
 
    private:
@@ -20,6 +20,9 @@
 
 #include "evaluate_nnue.h"
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -27,10 +30,12 @@
 #include <iomanip>
 #include <iostream>
 #include <optional>
+#include <random>
 #include <sstream>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include "../evaluate.h"
 #include "../misc.h"
@@ -94,9 +99,317 @@ bool write_parameters(std::ostream& stream, const T& reference) {
 }  // namespace Detail
 
 
+static void unmap(NetSize netSize);
+
+// Pre-decoded networks. A blob holds a Header and the net description, then the
+// feature transformer and every layer stack exactly as read_parameters() leaves them
+// in memory, each starting at a multiple of Alignment. Mapping a blob read-only
+// replaces decoding, and all processes mapping the same blob share its pages. The
+// header keeps a checksum of the description and the objects, which save() checks
+// against the written file before renaming it into place. map() only checks the
+// header and the size, so that a truncated or stale blob is decoded again while
+// mapping stays as cheap as reading the header.
+namespace Blob {
+
+constexpr char          Magic[8]    = {'N', 'N', 'U', 'E', 'B', 'L', 'O', 'B'};
+constexpr std::uint32_t Version     = 2;
+constexpr std::size_t   Alignment   = 4096;
+constexpr std::size_t   SampleBytes = 64 * 1024;
+
+struct Header {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t hashValue;
+    std::uint64_t sourceHash;
+    char          simd[16];
+    std::uint64_t transformerSize;
+    std::uint64_t networkSize;
+    std::uint32_t layerStacks;
+    std::uint32_t descriptionSize;
+    std::uint64_t payloadHash;
+};
+
+struct Mapping {
+    const void* mem  = nullptr;
+    std::size_t size = 0;
+};
+
+// The mapped objects of each net size belong to the mapping and not to the allocators
+// behind the smart pointers. Those are defined earlier in this file, so they are
+// destroyed later and find the objects handed back at exit.
+struct Mappings {
+    Mapping bySize[2];
+
+    ~Mappings() {
+        unmap(Big);
+        unmap(Small);
+    }
+} mapped;
+
+std::size_t align(std::size_t n) { return (n + Alignment - 1) / Alignment * Alignment; }
+
+std::uint64_t fnv1a(std::uint64_t hash, const char* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i)
+        hash = (hash ^ std::uint8_t(data[i])) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Identifies the source of a blob by its size and its first and last SampleBytes,
+// which hold the header, the description and the last layer stacks. Reading the
+// whole net would cost as much as decoding it. Returns 0 if the stream can't seek.
+std::uint64_t source_hash(std::istream& stream) {
+
+    const auto start = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    const auto end = stream.tellg();
+    if (start == std::streampos(-1) || end == std::streampos(-1))
+    {
+        stream.clear();
+        stream.seekg(start);
+        return 0;
+    }
+
+    const std::uint64_t size   = std::uint64_t(end - start);
+    const std::size_t   sample = std::size_t(std::min<std::uint64_t>(size, SampleBytes));
+    std::string         buffer(sample, '\0');
+
+    std::uint64_t hash = fnv1a(0xCBF29CE484222325ULL, reinterpret_cast<const char*>(&size),
+                               sizeof(size));
+
+    stream.seekg(start);
+    stream.read(&buffer[0], sample);
+    hash = fnv1a(hash, buffer.data(), sample);
+
+    stream.seekg(end - std::streamoff(sample));
+    stream.read(&buffer[0], sample);
+    hash = fnv1a(hash, buffer.data(), sample);
+
+    stream.clear();
+    stream.seekg(start);
+    return stream ? hash | 1 : 0;
+}
+
+// Checksum of size bytes at data, a 64-bit word at a time, the last one zero padded.
+// Much faster than fnv1a() byte by byte, which matters for the hundred MB of a big net.
+std::uint64_t checksum(std::uint64_t hash, const void* data, std::size_t size) {
+
+    const char*   bytes = static_cast<const char*>(data);
+    std::uint64_t word;
+    for (; size >= sizeof(word); bytes += sizeof(word), size -= sizeof(word))
+    {
+        std::memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 32;
+    }
+    word = 0;
+    std::memcpy(&word, bytes, size);
+    hash = (hash ^ word) * 0x100000001B3ULL;
+    return hash ^ (hash >> 32);
+}
+
+// Checksum of what a blob holds after its Header, as the objects in memory and not
+// their file layout, so that save() computes it before writing the blob
+template<typename Transformer, typename Net>
+std::uint64_t payload_hash(const std::string& description,
+                           const Transformer* transformer,
+                           const Net* const (&networks)[LayerStacks]) {
+
+    std::uint64_t hash = checksum(0xCBF29CE484222325ULL, description.data(), description.size());
+    hash               = checksum(hash, transformer, sizeof(Transformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        hash = checksum(hash, networks[i], sizeof(Net));
+    return hash;
+}
+
+template<typename Transformer, typename Net>
+Header make_header(NetSize netSize, std::uint64_t sourceHash, const std::string& description) {
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    std::strncpy(header.simd, SimdName, sizeof(header.simd) - 1);
+    header.version         = Version;
+    header.hashValue       = HashValue[netSize];
+    header.sourceHash      = sourceHash;
+    header.transformerSize = sizeof(Transformer);
+    header.networkSize     = sizeof(Net);
+    header.layerStacks     = LayerStacks;
+    header.descriptionSize = std::uint32_t(description.size());
+    return header;
+}
+
+std::size_t blob_size(const Header& header) {
+    return align(sizeof(Header) + header.descriptionSize) + align(header.transformerSize)
+         + header.layerStacks * align(header.networkSize);
+}
+
+// Points transformer and networks at their place in the blob at base
+template<typename Transformer, typename Net>
+void locate(const char*         base,
+            const Header&       header,
+            const Transformer*& transformer,
+            const Net* (&networks)[LayerStacks]) {
+
+    std::size_t offset = align(sizeof(Header) + header.descriptionSize);
+    transformer        = reinterpret_cast<const Transformer*>(base + offset);
+    offset += align(sizeof(Transformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i, offset += align(sizeof(Net)))
+        networks[i] = reinterpret_cast<const Net*>(base + offset);
+}
+
+// Whether the blob file at path holds the payload its header claims, read back
+// through a fresh mapping so that it checks what was written and not the objects
+template<typename Transformer, typename Net>
+bool verify(const std::string& path, const Header& written) {
+
+    std::size_t size = 0;
+    const void* mem  = map_file(path, size);
+    if (!mem)
+        return false;
+
+    const char* base = static_cast<const char*>(mem);
+    Header      header;
+    bool        ok = size == blob_size(written);
+    if (ok)
+    {
+        std::memcpy(&header, base, sizeof(Header));
+        ok = !std::memcmp(&header, &written, sizeof(Header));
+    }
+    if (ok)
+    {
+        const Transformer* transformer;
+        const Net*         networks[LayerStacks];
+        locate(base, header, transformer, networks);
+        ok = payload_hash(std::string(base + sizeof(Header), header.descriptionSize),
+                          transformer, networks)
+          == header.payloadHash;
+    }
+    unmap_file(mem, size);
+    return ok;
+}
+
+template<typename Transformer, typename Net>
+bool map(const std::string&          path,
+         NetSize                     netSize,
+         std::uint64_t               sourceHash,
+         LargePagePtr<Transformer>&  transformer,
+         AlignedPtr<Net>             (&networks)[LayerStacks],
+         std::string&                netDescription) {
+
+    std::size_t size = 0;
+    const void* mem  = map_file(path, size);
+    if (!mem)
+        return false;
+
+    const char* base = static_cast<const char*>(mem);
+    Header      header;
+    if (size < sizeof(Header))
+    {
+        unmap_file(mem, size);
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(Header));
+
+    Header expected = make_header<Transformer, Net>(netSize, sourceHash, "");
+    expected.descriptionSize = header.descriptionSize;
+    expected.payloadHash     = header.payloadHash;
+    if (std::memcmp(&header, &expected, sizeof(Header)) || size != blob_size(header))
+    {
+        unmap_file(mem, size);
+        return false;
+    }
+
+    // The payload was checked by save(), pages come in as the first evaluations touch them
+    const Transformer* mappedTransformer;
+    const Net*         mappedNetworks[LayerStacks];
+    locate(base, header, mappedTransformer, mappedNetworks);
+
+    // Read only: evaluating never writes to the networks
+    netDescription.assign(base + sizeof(Header), header.descriptionSize);
+    transformer.reset(const_cast<Transformer*>(mappedTransformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        networks[i].reset(const_cast<Net*>(mappedNetworks[i]));
+
+    mapped.bySize[netSize] = {mem, size};
+    return true;
+}
+
+template<typename Transformer, typename Net>
+bool save(const std::string&               path,
+          NetSize                          netSize,
+          std::uint64_t                    sourceHash,
+          const LargePagePtr<Transformer>& transformer,
+          const AlignedPtr<Net>            (&networks)[LayerStacks],
+          const std::string&               netDescription) {
+
+    const Net* objects[LayerStacks];
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        objects[i] = networks[i].get();
+
+    Header header      = make_header<Transformer, Net>(netSize, sourceHash, netDescription);
+    header.payloadHash = payload_hash(netDescription, transformer.get(), objects);
+    const std::string padding(Alignment, '\0');
+
+    auto write_padded = [&](std::ostream& stream, const void* data, std::size_t size) {
+        stream.write(static_cast<const char*>(data), size);
+        stream.write(padding.data(), align(size) - size);
+    };
+
+    // Written under a unique name and renamed into place, so that processes starting
+    // at the same time never map a partial blob
+    std::random_device rd;
+    const std::string  tmpPath = path + ".tmp" + std::to_string(rd());
+    {
+        std::ofstream stream(tmpPath, std::ios::binary);
+        const std::size_t headerSize = sizeof(Header) + netDescription.size();
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        stream.write(netDescription.data(), netDescription.size());
+        stream.write(padding.data(), align(headerSize) - headerSize);
+        write_padded(stream, transformer.get(), sizeof(Transformer));
+        for (std::size_t i = 0; i < LayerStacks; ++i)
+            write_padded(stream, networks[i].get(), sizeof(Net));
+
+        stream.close();
+        if (!stream || !verify<Transformer, Net>(tmpPath, header))
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace Blob
+
+
+// Hands the objects of a mapped blob back to the mapping before they are replaced
+static void unmap(NetSize netSize) {
+
+    Blob::Mapping& m = Blob::mapped.bySize[netSize];
+    if (!m.mem)
+        return;
+
+    if (netSize == Small)
+    {
+        featureTransformerSmall.release();
+        for (std::size_t i = 0; i < LayerStacks; ++i)
+            networkSmall[i].release();
+    }
+    else
+    {
+        featureTransformerBig.release();
+        for (std::size_t i = 0; i < LayerStacks; ++i)
+            networkBig[i].release();
+    }
+
+    unmap_file(m.mem, m.size);
+    m = {};
+}
+
 // Initialize the evaluation function parameters
 static void initialize(NetSize netSize) {
 
+    unmap(netSize);
+
     if (netSize == Small)
     {
         Detail::initialize(featureTransformerSmall);
@@ -176,18 +489,19 @@ write_parameters(std::ostream& stream, NetSize netSize, const std::string& netDe
     return bool(stream);
 }
 
-void hint_common_parent_position(const Position& pos) {
+void hint_common_parent_position(const Position& pos, AccumulatorCaches* caches) {
 
     int simpleEval = simple_eval(pos, pos.side_to_move());
     if (std::abs(simpleEval) > 1050)
-        featureTransformerSmall->hint_common_access(pos);
+        featureTransformerSmall->hint_common_access(pos, caches ? &caches->small : nullptr);
     else
-        featureTransformerBig->hint_common_access(pos);
+        featureTransformerBig->hint_common_access(pos, caches ? &caches->big : nullptr);
 }
 
-// Evaluation function. Perform differential calculation.
+// Evaluation function. Perform differential calculation. Refreshes go through the
+// thread's caches when given.
 template<NetSize Net_Size>
-Value evaluate(const Position& pos, bool adjusted, int* complexity) {
+Value evaluate(const Position& pos, bool adjusted, int* complexity, AccumulatorCaches* caches) {
 
     // We manually align the arrays on the stack because with gcc < 9.3
     // overaligning stack variables with alignas() doesn't work correctly.
@@ -213,9 +527,12 @@ Value evaluate(const Position& pos, bool adjusted, int* complexity) {
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
     const int  bucket     = (pos.count<ALL_PIECES>() - 1) / 4;
-    const auto psqt       = Net_Size == Small
-                            ? featureTransformerSmall->transform(pos, transformedFeatures, bucket)
-                            : featureTransformerBig->transform(pos, transformedFeatures, bucket);
+    const auto psqt =
+      Net_Size == Small
+        ? featureTransformerSmall->transform(pos, transformedFeatures, bucket,
+                                             caches ? &caches->small : nullptr)
+        : featureTransformerBig->transform(pos, transformedFeatures, bucket,
+                                           caches ? &caches->big : nullptr);
     const auto positional = Net_Size == Small ? networkSmall[bucket]->propagate(transformedFeatures)
                                               : networkBig[bucket]->propagate(transformedFeatures);
 
@@ -230,8 +547,145 @@ Value evaluate(const Position& pos, bool adjusted, int* complexity) {
         return static_cast<Value>((psqt + positional) / OutputScale);
 }
 
-template Value evaluate<Big>(const Position& pos, bool adjusted, int* complexity);
-template Value evaluate<Small>(const Position& pos, bool adjusted, int* complexity);
+template Value
+evaluate<Big>(const Position& pos, bool adjusted, int* complexity, AccumulatorCaches* caches);
+template Value
+evaluate<Small>(const Position& pos, bool adjusted, int* complexity, AccumulatorCaches* caches);
+
+// The PSQT term of evaluate() alone, without propagating through the layer stack. The
+// accumulators are still brought up to date, so a later evaluate() of the position
+// only pays for the layers.
+template<NetSize Net_Size>
+Value evaluate_psqt(const Position& pos, AccumulatorCaches* caches) {
+
+    const int  bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+    const auto psqt =
+      Net_Size == Small
+        ? featureTransformerSmall->transform_psqt(pos, bucket, caches ? &caches->small : nullptr)
+        : featureTransformerBig->transform_psqt(pos, bucket, caches ? &caches->big : nullptr);
+
+    return static_cast<Value>(psqt / OutputScale);
+}
+
+template Value evaluate_psqt<Big>(const Position& pos, AccumulatorCaches* caches);
+template Value evaluate_psqt<Small>(const Position& pos, AccumulatorCaches* caches);
+
+// Batched evaluation of up to MaxBatchSize positions whose accumulators are not computed
+// yet. The feature transformer refreshes them together, then the positions go through
+// the layer stacks grouped by bucket, so each stack's weights are loaded once per group.
+template<NetSize Net_Size>
+void evaluate(const Position* const pos[], int count, Value out[], bool adjusted, int complexity[]) {
+
+    assert(count <= MaxBatchSize);
+
+    if (Net_Size == Small)
+        featureTransformerSmall->refresh_accumulators(pos, count);
+    else
+        featureTransformerBig->refresh_accumulators(pos, count);
+
+    int order[MaxBatchSize], bucket[MaxBatchSize];
+    for (int i = 0; i < count; ++i)
+    {
+        bucket[i] = (pos[i]->count<ALL_PIECES>() - 1) / 4;
+        order[i]  = i;
+    }
+    std::stable_sort(order, order + count, [&](int a, int b) { return bucket[a] < bucket[b]; });
+
+    // The accumulators are computed, so evaluate() only transforms and propagates
+    for (int i = 0; i < count; ++i)
+    {
+        const int k = order[i];
+        out[k]      = evaluate<Net_Size>(*pos[k], adjusted, complexity ? &complexity[k] : nullptr);
+    }
+}
+
+template void
+evaluate<Big>(const Position* const pos[], int count, Value out[], bool adjusted, int complexity[]);
+template void
+evaluate<Small>(const Position* const pos[], int count, Value out[], bool adjusted, int complexity[]);
+
+namespace Layers {
+struct DenseBench {
+    template<typename Layer>
+    static void propagate(const Layer&                         layer,
+                          const typename Layer::InputType*     input,
+                          typename Layer::OutputType*          output) {
+        layer.template propagate_blocks<false>(input, output);
+    }
+};
+}  // namespace Layers
+
+// Runs the first hidden layer of the big net over the transformed features of every
+// position, iterations times, once through the sparse kernel and once through the dense
+// one. Each position uses the layer stack of its own bucket.
+FirstLayerBench bench_first_layer(const Position* const pos[], int count, int iterations) {
+
+    using Layer = decltype(networkBig[0]->fc_0);
+
+    struct alignas(CacheLineSize) Input {
+        TransformedFeatureType features[Layer::InputDimensions];
+    };
+    struct alignas(CacheLineSize) Output {
+        typename Layer::OutputBuffer sparse, dense;
+    };
+
+    std::vector<Input> inputs(count);
+    std::vector<int>   buckets(count);
+    std::uint64_t      nonZero = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        buckets[i] = (pos[i]->count<ALL_PIECES>() - 1) / 4;
+        featureTransformerBig->transform(*pos[i], inputs[i].features, buckets[i]);
+
+        const auto* blocks = reinterpret_cast<const std::int32_t*>(inputs[i].features);
+        nonZero += std::count_if(blocks, blocks + Layer::InputDimensions / 4,
+                                 [](std::int32_t b) { return b != 0; });
+    }
+
+    // Reading an output after each call keeps the compiler from dropping the calls
+    Output                 output{};
+    volatile std::int32_t sink;
+    auto                   time = [&](bool sparse) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < iterations; ++n)
+            for (int i = 0; i < count; ++i)
+            {
+                const Layer& layer = networkBig[buckets[i]]->fc_0;
+                if (sparse)
+                    layer.propagate(inputs[i].features, output.sparse);
+                else
+                    Layers::DenseBench::propagate(layer, inputs[i].features, output.dense);
+                sink = sparse ? output.sparse[0] : output.dense[0];
+            }
+        const std::chrono::duration<double, std::nano> elapsed =
+          std::chrono::steady_clock::now() - start;
+        return elapsed.count() / (double(count) * iterations);
+    };
+
+    FirstLayerBench result{};
+    result.nnzRatio = double(nonZero) / (double(count) * (Layer::InputDimensions / 4));
+
+    // A first untimed round brings the weights into the caches
+    time(true);
+    time(false);
+    result.sparseNs  = time(true);
+    result.denseNs   = time(false);
+    result.identical = true;
+
+    // Both paths must agree bit for bit on every position
+    for (int i = 0; i < count; ++i)
+    {
+        const Layer& layer = networkBig[buckets[i]]->fc_0;
+        layer.propagate(inputs[i].features, output.sparse);
+        Layers::DenseBench::propagate(layer, inputs[i].features, output.dense);
+        if (std::memcmp(output.sparse, output.dense,
+                        Layer::OutputDimensions * sizeof(typename Layer::OutputType)))
+            result.identical = false;
+    }
+
+    return result;
+}
 
 struct NnueEvalTrace {
     static_assert(LayerStacks == PSQTBuckets);
@@ -432,6 +886,56 @@ std::optional<std::string> load_eval(std::istream& stream, NetSize netSize) {
                                                             : std::nullopt;
 }
 
+// Describes the memory of the feature transformer, whose weight columns are gathered
+// by feature index and so make the most of huge pages
+std::string memory_info(NetSize netSize) {
+
+    const void* mem = netSize == Small ? static_cast<const void*>(featureTransformerSmall.get())
+                                       : static_cast<const void*>(featureTransformerBig.get());
+    const std::size_t size = netSize == Small ? sizeof(*featureTransformerSmall)
+                                              : sizeof(*featureTransformerBig);
+    const std::size_t MB   = 1024 * 1024;
+
+    std::stringstream ss;
+    ss << (Blob::mapped.bySize[netSize].mem ? "mapped blob" : large_pages_kind(mem)) << ", "
+       << (huge_page_bytes(mem, size) + MB / 2) / MB << " of " << (size + MB / 2) / MB
+       << " MB on huge pages";
+    return ss.str();
+}
+
+// Load eval through the pre-decoded blob at blobFile: map it if it was made from the
+// same source, otherwise decode the stream and (re)write the blob for the next start
+std::optional<std::string>
+load_eval(std::istream& stream, NetSize netSize, const std::string& blobFile) {
+
+    const std::uint64_t sourceHash = Blob::source_hash(stream);
+    if (!sourceHash)
+        return load_eval(stream, netSize);
+
+    std::string netDescription;
+    unmap(netSize);
+
+    bool mapped = netSize == Small
+                  ? Blob::map(blobFile, netSize, sourceHash, featureTransformerSmall, networkSmall,
+                              netDescription)
+                  : Blob::map(blobFile, netSize, sourceHash, featureTransformerBig, networkBig,
+                              netDescription);
+    if (mapped)
+        return netDescription;
+
+    auto description = load_eval(stream, netSize);
+    if (description.has_value())
+    {
+        if (netSize == Small)
+            Blob::save(blobFile, netSize, sourceHash, featureTransformerSmall, networkSmall,
+                       description.value());
+        else
+            Blob::save(blobFile, netSize, sourceHash, featureTransformerBig, networkBig,
+                       description.value());
+    }
+    return description;
+}
+
 // Save eval, to a file stream or a memory stream
 bool save_eval(std::ostream&      stream,
                NetSize            netSize,
@@ -76,10 +76,36 @@ using LargePagePtr = std::unique_ptr<T, LargePageDeleter<T>>;
 
 std::string trace(Position& pos);
 template<NetSize Net_Size>
-Value evaluate(const Position& pos, bool adjusted = false, int* complexity = nullptr);
-void  hint_common_parent_position(const Position& pos);
+Value evaluate(const Position&    pos,
+               bool               adjusted   = false,
+               int*               complexity = nullptr,
+               AccumulatorCaches* caches     = nullptr);
+template<NetSize Net_Size>
+Value evaluate_psqt(const Position& pos, AccumulatorCaches* caches = nullptr);
+template<NetSize Net_Size>
+void evaluate(const Position* const pos[],
+              int                   count,
+              Value                 out[],
+              bool                  adjusted     = false,
+              int                   complexity[] = nullptr);
+void  hint_common_parent_position(const Position& pos, AccumulatorCaches* caches = nullptr);
+
+// Timings of the first hidden layer of the big net on a set of positions, see
+// bench_first_layer(). A block is the group of 4 transformed features the sparse
+// layer skips when they are all zero.
+struct FirstLayerBench {
+    double nnzRatio;  // share of nonzero input blocks
+    double sparseNs;  // per propagate
+    double denseNs;
+    bool   identical;  // both paths gave the same outputs
+};
+
+FirstLayerBench bench_first_layer(const Position* const pos[], int count, int iterations);
 
+std::string                memory_info(NetSize netSize);
 std::optional<std::string> load_eval(std::istream& stream, NetSize netSize);
+std::optional<std::string>
+load_eval(std::istream& stream, NetSize netSize, const std::string& blobFile);
 bool                       save_eval(std::ostream&      stream,
                                      NetSize            netSize,
                                      const std::string& name,
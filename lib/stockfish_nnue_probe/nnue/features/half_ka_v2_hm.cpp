@@ -76,6 +76,44 @@ template void HalfKAv2_hm::append_changed_indices<BLACK>(Square            ksq,
                                                          IndexList&        removed,
                                                          IndexList&        added);
 
+// Get a list of indices for the pieces that differ from cached piece bitboards
+template<Color Perspective>
+void HalfKAv2_hm::append_changed_indices(Square          ksq,
+                                         const Bitboard  byColorBB[],
+                                         const Bitboard  byTypeBB[],
+                                         const Position& pos,
+                                         IndexList&      removed,
+                                         IndexList&      added) {
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+        {
+            const Piece    pc       = make_piece(c, pt);
+            const Bitboard oldBB    = byColorBB[c] & byTypeBB[pt];
+            const Bitboard newBB    = pos.pieces(c, pt);
+            Bitboard       toRemove = oldBB & ~newBB;
+            Bitboard       toAdd    = newBB & ~oldBB;
+
+            while (toRemove)
+                removed.push_back(make_index<Perspective>(pop_lsb(toRemove), pc, ksq));
+            while (toAdd)
+                added.push_back(make_index<Perspective>(pop_lsb(toAdd), pc, ksq));
+        }
+}
+
+// Explicit template instantiations
+template void HalfKAv2_hm::append_changed_indices<WHITE>(Square          ksq,
+                                                         const Bitboard  byColorBB[],
+                                                         const Bitboard  byTypeBB[],
+                                                         const Position& pos,
+                                                         IndexList&      removed,
+                                                         IndexList&      added);
+template void HalfKAv2_hm::append_changed_indices<BLACK>(Square          ksq,
+                                                         const Bitboard  byColorBB[],
+                                                         const Bitboard  byTypeBB[],
+                                                         const Position& pos,
+                                                         IndexList&      removed,
+                                                         IndexList&      added);
+
 int HalfKAv2_hm::update_cost(const StateInfo* st) { return st->dirtyPiece.dirty_num; }
 
 int HalfKAv2_hm::refresh_cost(const Position& pos) { return pos.count<ALL_PIECES>(); }
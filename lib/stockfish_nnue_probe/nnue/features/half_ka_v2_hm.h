@@ -135,6 +135,16 @@ class HalfKAv2_hm {
     static void
     append_changed_indices(Square ksq, const DirtyPiece& dp, IndexList& removed, IndexList& added);
 
+    // Get a list of indices for the pieces that differ between the given piece
+    // bitboards, taken with the king on ksq, and the position
+    template<Color Perspective>
+    static void append_changed_indices(Square          ksq,
+                                       const Bitboard  byColorBB[],
+                                       const Bitboard  byTypeBB[],
+                                       const Position& pos,
+                                       IndexList&      removed,
+                                       IndexList&      added);
+
     // Returns the cost of updating one perspective, the most costly one.
     // Assumes no refresh needed.
     static int update_cost(const StateInfo* st);
@@ -37,6 +37,9 @@
 
 namespace Stockfish::Eval::NNUE::Layers {
 
+// Runs the dense variant of AffineTransformSparseInput, for bench_first_layer() only
+struct DenseBench;
+
 #if (USE_SSSE3 | (USE_NEON >= 8))
 alignas(CacheLineSize) static inline const
   std::array<std::array<std::uint16_t, 8>, 256> lookup_indices = []() {
@@ -198,32 +201,52 @@ class AffineTransformSparseInput {
     }
     // Forward propagation
     void propagate(const InputType* input, OutputType* output) const {
+        propagate_blocks<true>(input, output);
+    }
+
+   private:
+    friend struct DenseBench;
+
+    // Without Sparse, every input block is multiplied instead of only the nonzero ones,
+    // with the same result, which measures what the sparse path saves
+    template<bool Sparse>
+    void propagate_blocks(const InputType* input, OutputType* output) const {
 
 #if (USE_SSSE3 | (USE_NEON >= 8))
     #if defined(USE_AVX512)
         using invec_t  = __m512i;
         using outvec_t = __m512i;
         #define vec_set_32 _mm512_set1_epi32
+        #define vec_zero_32 _mm512_setzero_si512
+        #define vec_add_32 _mm512_add_epi32
         #define vec_add_dpbusd_32 Simd::m512_add_dpbusd_epi32
     #elif defined(USE_AVX2)
         using invec_t  = __m256i;
         using outvec_t = __m256i;
         #define vec_set_32 _mm256_set1_epi32
+        #define vec_zero_32 _mm256_setzero_si256
+        #define vec_add_32 _mm256_add_epi32
         #define vec_add_dpbusd_32 Simd::m256_add_dpbusd_epi32
     #elif defined(USE_SSSE3)
         using invec_t  = __m128i;
         using outvec_t = __m128i;
         #define vec_set_32 _mm_set1_epi32
+        #define vec_zero_32 _mm_setzero_si128
+        #define vec_add_32 _mm_add_epi32
         #define vec_add_dpbusd_32 Simd::m128_add_dpbusd_epi32
     #elif defined(USE_NEON_DOTPROD)
         using invec_t  = int8x16_t;
         using outvec_t = int32x4_t;
         #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_zero_32() vdupq_n_s32(0)
+        #define vec_add_32 vaddq_s32
         #define vec_add_dpbusd_32 Simd::dotprod_m128_add_dpbusd_epi32
     #elif defined(USE_NEON)
         using invec_t  = int8x16_t;
         using outvec_t = int32x4_t;
         #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_zero_32() vdupq_n_s32(0)
+        #define vec_add_32 vaddq_s32
         #define vec_add_dpbusd_32 Simd::neon_m128_add_dpbusd_epi32
     #endif
         static constexpr IndexType OutputSimdWidth = sizeof(outvec_t) / sizeof(OutputType);
@@ -231,32 +254,60 @@ class AffineTransformSparseInput {
         constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
         constexpr IndexType NumRegs   = OutputDimensions / OutputSimdWidth;
         std::uint16_t       nnz[NumChunks];
-        IndexType           count;
+        IndexType           count = NumChunks;
 
         const auto input32 = reinterpret_cast<const std::int32_t*>(input);
 
         // Find indices of nonzero 32-bit blocks
-        find_nnz<NumChunks>(input32, nnz, count);
+        if (Sparse)
+            find_nnz<NumChunks>(input32, nnz, count);
+
+        // With few output registers, as with 16 outputs in one 512-bit register, every
+        // block would wait for the previous multiply-add into the same register. Blocks
+        // are therefore spread over NumAccums independent sums, added up at the end.
+        constexpr IndexType NumAccums = std::max<IndexType>(1, 4 / NumRegs);
 
         const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
-        outvec_t        acc[NumRegs];
+        outvec_t        acc[NumAccums][NumRegs];
         for (IndexType k = 0; k < NumRegs; ++k)
-            acc[k] = biasvec[k];
+        {
+            acc[0][k] = biasvec[k];
+            for (IndexType a = 1; a < NumAccums; ++a)
+                acc[a][k] = vec_zero_32();
+        }
 
-        for (IndexType j = 0; j < count; ++j)
+        IndexType j = 0;
+        for (; j + NumAccums <= count; j += NumAccums)
+            for (IndexType a = 0; a < NumAccums; ++a)
+            {
+                const auto    i  = Sparse ? nnz[j + a] : j + a;
+                const invec_t in = vec_set_32(input32[i]);
+                const auto    col =
+                  reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    vec_add_dpbusd_32(acc[a][k], in, col[k]);
+            }
+
+        for (; j < count; ++j)
         {
-            const auto    i  = nnz[j];
+            const auto    i  = Sparse ? nnz[j] : j;
             const invec_t in = vec_set_32(input32[i]);
             const auto    col =
               reinterpret_cast<const invec_t*>(&weights[i * OutputDimensions * ChunkSize]);
             for (IndexType k = 0; k < NumRegs; ++k)
-                vec_add_dpbusd_32(acc[k], in, col[k]);
+                vec_add_dpbusd_32(acc[0][k], in, col[k]);
         }
 
         outvec_t* outptr = reinterpret_cast<outvec_t*>(output);
         for (IndexType k = 0; k < NumRegs; ++k)
-            outptr[k] = acc[k];
+        {
+            for (IndexType a = 1; a < NumAccums; ++a)
+                acc[0][k] = vec_add_32(acc[0][k], acc[a][k]);
+            outptr[k] = acc[0][k];
+        }
     #undef vec_set_32
+    #undef vec_zero_32
+    #undef vec_add_32
     #undef vec_add_dpbusd_32
 #else
         // Use dense implementation for the other architectures.
@@ -265,7 +316,6 @@ class AffineTransformSparseInput {
 #endif
     }
 
-   private:
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
 
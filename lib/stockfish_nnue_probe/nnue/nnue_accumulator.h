@@ -22,7 +22,9 @@
 #define NNUE_ACCUMULATOR_H_INCLUDED
 
 #include <cstdint>
+#include <cstring>
 
+#include "../types.h"
 #include "nnue_architecture.h"
 #include "nnue_common.h"
 
@@ -36,6 +38,43 @@ struct alignas(CacheLineSize) Accumulator {
     bool         computed[2];
 };
 
+// Per-thread refresh cache ("Finny tables"). For every king square and perspective
+// it keeps the accumulator of the last position refreshed there, together with the
+// pieces of that position. A refresh then starts from the entry and only applies the
+// pieces that differ, instead of adding every active feature to the biases. The
+// cache must be cleared when other networks are loaded.
+struct AccumulatorCaches {
+
+    template<IndexType Size>
+    struct alignas(CacheLineSize) Cache {
+
+        struct alignas(CacheLineSize) Entry {
+            std::int16_t  accumulation[Size];
+            std::int32_t  psqtAccumulation[PSQTBuckets];
+            Bitboard      byColorBB[COLOR_NB];
+            Bitboard      byTypeBB[PIECE_TYPE_NB];
+            bool          initialized;
+        };
+
+        Entry entries[SQUARE_NB][COLOR_NB];
+
+        Entry& operator()(Square ksq, Color perspective) { return entries[ksq][perspective]; }
+
+        // Entries are filled with the biases of the network on first use
+        void clear() { std::memset(static_cast<void*>(entries), 0, sizeof(entries)); }
+    };
+
+    AccumulatorCaches() { clear(); }
+
+    void clear() {
+        big.clear();
+        small.clear();
+    }
+
+    Cache<TransformedFeatureDimensionsBig>   big;
+    Cache<TransformedFeatureDimensionsSmall> small;
+};
+
 }  // namespace Stockfish::Eval::NNUE
 
 #endif  // NNUE_ACCUMULATOR_H_INCLUDED
@@ -58,6 +58,29 @@ constexpr int WeightScaleBits = 6;
 // Size of cache line (in bytes)
 constexpr std::size_t CacheLineSize = 64;
 
+// Largest number of positions evaluated together by the batched evaluation
+constexpr int MaxBatchSize = 16;
+
+// Instruction set the kernels are compiled for. It also names the weight layout,
+// since the layers permute their weights for the SIMD width on load.
+#if defined(USE_VNNI) && defined(USE_AVX512)
+constexpr const char* SimdName = "vnni512";
+#elif defined(USE_AVX512)
+constexpr const char* SimdName = "avx512";
+#elif defined(USE_AVX2)
+constexpr const char* SimdName = "avx2";
+#elif defined(USE_SSE41)
+constexpr const char* SimdName = "sse41";
+#elif defined(USE_SSSE3)
+constexpr const char* SimdName = "ssse3";
+#elif defined(USE_SSE2)
+constexpr const char* SimdName = "sse2";
+#elif defined(USE_NEON)
+constexpr const char* SimdName = "neon";
+#else
+constexpr const char* SimdName = "generic";
+#endif
+
 constexpr const char        Leb128MagicString[]   = "COMPRESSED_LEB128";
 constexpr const std::size_t Leb128MagicStringSize = sizeof(Leb128MagicString) - 1;
 
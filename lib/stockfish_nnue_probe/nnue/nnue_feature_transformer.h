@@ -224,6 +224,9 @@ class FeatureTransformer {
     // Size of forward propagation buffer
     static constexpr std::size_t BufferSize = OutputDimensions * sizeof(OutputType);
 
+    // Refresh cache of one thread, see AccumulatorCaches
+    using Cache = AccumulatorCaches::Cache<HalfDimensions>;
+
     // Hash value embedded in the evaluation file
     static constexpr std::uint32_t get_hash_value() {
         return FeatureSet::HashValue ^ (OutputDimensions * 2);
@@ -250,9 +253,10 @@ class FeatureTransformer {
     }
 
     // Convert input features
-    std::int32_t transform(const Position& pos, OutputType* output, int bucket) const {
-        update_accumulator<WHITE>(pos);
-        update_accumulator<BLACK>(pos);
+    std::int32_t
+    transform(const Position& pos, OutputType* output, int bucket, Cache* cache = nullptr) const {
+        update_accumulator<WHITE>(pos, cache);
+        update_accumulator<BLACK>(pos, cache);
 
         const Color perspectives[2]  = {pos.side_to_move(), ~pos.side_to_move()};
         const auto& accumulation     = (pos.state()->*accPtr).accumulation;
@@ -312,9 +316,28 @@ class FeatureTransformer {
         return psqt;
     }  // end of function transform()
 
-    void hint_common_access(const Position& pos) const {
-        hint_common_access_for_perspective<WHITE>(pos);
-        hint_common_access_for_perspective<BLACK>(pos);
+    // Brings the accumulators up to date like transform(), but only returns the PSQT
+    // part of the output, skipping the conversion of the accumulation.
+    std::int32_t transform_psqt(const Position& pos, int bucket, Cache* cache = nullptr) const {
+        update_accumulator<WHITE>(pos, cache);
+        update_accumulator<BLACK>(pos, cache);
+
+        const Color perspectives[2]  = {pos.side_to_move(), ~pos.side_to_move()};
+        const auto& psqtAccumulation = (pos.state()->*accPtr).psqtAccumulation;
+
+        return (psqtAccumulation[perspectives[0]][bucket] - psqtAccumulation[perspectives[1]][bucket])
+             / 2;
+    }
+
+    void hint_common_access(const Position& pos, Cache* cache = nullptr) const {
+        hint_common_access_for_perspective<WHITE>(pos, cache);
+        hint_common_access_for_perspective<BLACK>(pos, cache);
+    }
+
+    // Refreshes the accumulators of up to MaxBatchSize positions together.
+    void refresh_accumulators(const Position* const pos[], int count) const {
+        refresh_accumulators<WHITE>(pos, count);
+        refresh_accumulators<BLACK>(pos, count);
     }
 
    private:
@@ -655,8 +678,298 @@ class FeatureTransformer {
 #endif
     }
 
+    // Refreshes from the cache entry of the perspective's king square: the entry is
+    // brought up to date with the pieces that changed since it was last used there
+    // and then copied into the accumulator.
+    template<Color Perspective>
+    void update_accumulator_refresh_cache(const Position& pos, Cache& cache) const {
+        const Square ksq   = pos.square<KING>(Perspective);
+        auto&        entry = cache(ksq, Perspective);
+
+        FeatureSet::IndexList removed, added;
+        if (entry.initialized)
+            FeatureSet::append_changed_indices<Perspective>(ksq, entry.byColorBB, entry.byTypeBB,
+                                                            pos, removed, added);
+
+        // A cleared entry holds no pieces, and one last used for a very different position
+        // costs more to update than starting over, so both restart from the biases alone
+        if (!entry.initialized
+            || removed.size() + added.size() >= std::size_t(pos.count<ALL_PIECES>()))
+        {
+            std::memcpy(entry.accumulation, biases, sizeof(biases));
+            std::memset(entry.psqtAccumulation, 0, sizeof(entry.psqtAccumulation));
+            entry.initialized = true;
+
+            removed = added = FeatureSet::IndexList();
+            FeatureSet::append_active_indices<Perspective>(pos, added);
+        }
+
+        auto& accumulator                 = pos.state()->*accPtr;
+        accumulator.computed[Perspective] = true;
+
+#ifdef VECTOR
+        vec_t      acc[NumRegs];
+        psqt_vec_t psqt[NumPsqtRegs];
+
+        for (IndexType j = 0; j < HalfDimensions / TileHeight; ++j)
+        {
+            auto entryTile = reinterpret_cast<vec_t*>(&entry.accumulation[j * TileHeight]);
+            for (IndexType k = 0; k < NumRegs; ++k)
+                acc[k] = vec_load(&entryTile[k]);
+
+            for (const auto index : removed)
+            {
+                const IndexType offset = HalfDimensions * index + j * TileHeight;
+                auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    acc[k] = vec_sub_16(acc[k], column[k]);
+            }
+            for (const auto index : added)
+            {
+                const IndexType offset = HalfDimensions * index + j * TileHeight;
+                auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    acc[k] = vec_add_16(acc[k], column[k]);
+            }
+
+            auto accTile =
+              reinterpret_cast<vec_t*>(&accumulator.accumulation[Perspective][j * TileHeight]);
+            for (IndexType k = 0; k < NumRegs; ++k)
+            {
+                vec_store(&entryTile[k], acc[k]);
+                vec_store(&accTile[k], acc[k]);
+            }
+        }
+
+        for (IndexType j = 0; j < PSQTBuckets / PsqtTileHeight; ++j)
+        {
+            auto entryTilePsqt =
+              reinterpret_cast<psqt_vec_t*>(&entry.psqtAccumulation[j * PsqtTileHeight]);
+            for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                psqt[k] = vec_load_psqt(&entryTilePsqt[k]);
+
+            for (const auto index : removed)
+            {
+                const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+                auto columnPsqt        = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+                for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                    psqt[k] = vec_sub_psqt_32(psqt[k], columnPsqt[k]);
+            }
+            for (const auto index : added)
+            {
+                const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+                auto columnPsqt        = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+                for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                    psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
+            }
+
+            auto accTilePsqt = reinterpret_cast<psqt_vec_t*>(
+              &accumulator.psqtAccumulation[Perspective][j * PsqtTileHeight]);
+            for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+            {
+                vec_store_psqt(&entryTilePsqt[k], psqt[k]);
+                vec_store_psqt(&accTilePsqt[k], psqt[k]);
+            }
+        }
+#else
+        for (const auto index : removed)
+        {
+            const IndexType offset = HalfDimensions * index;
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+                entry.accumulation[j] -= weights[offset + j];
+            for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                entry.psqtAccumulation[k] -= psqtWeights[index * PSQTBuckets + k];
+        }
+        for (const auto index : added)
+        {
+            const IndexType offset = HalfDimensions * index;
+            for (IndexType j = 0; j < HalfDimensions; ++j)
+                entry.accumulation[j] += weights[offset + j];
+            for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                entry.psqtAccumulation[k] += psqtWeights[index * PSQTBuckets + k];
+        }
+
+        std::memcpy(accumulator.accumulation[Perspective], entry.accumulation,
+                    sizeof(entry.accumulation));
+        std::memcpy(accumulator.psqtAccumulation[Perspective], entry.psqtAccumulation,
+                    sizeof(entry.psqtAccumulation));
+#endif
+
+        for (Color c : {WHITE, BLACK})
+            entry.byColorBB[c] = pos.pieces(c);
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            entry.byTypeBB[pt] = pos.pieces(pt);
+    }
+
+    // A position starts from the accumulator of the previous one when their active
+    // features mostly overlap, as they do for siblings of one parent, and otherwise from
+    // the biases. All positions go through the weights tile by tile, so the columns they
+    // share are fetched from memory once per batch instead of once per position.
     template<Color Perspective>
-    void hint_common_access_for_perspective(const Position& pos) const {
+    void refresh_accumulators(const Position* const pos[], int count) const {
+        assert(count <= MaxBatchSize);
+
+        FeatureSet::IndexList active[MaxBatchSize], removed[MaxBatchSize], added[MaxBatchSize];
+        bool                  fromPrevious[MaxBatchSize];
+
+        for (int b = 0; b < count; ++b)
+        {
+            FeatureSet::append_active_indices<Perspective>(*pos[b], active[b]);
+            std::sort(active[b].begin(), active[b].end());
+            (pos[b]->state()->*accPtr).computed[Perspective] = true;
+
+            fromPrevious[b] = false;
+            if (b == 0)
+                continue;
+
+            const auto& prev = active[b - 1];
+            const auto& cur  = active[b];
+            std::size_t i = 0, k = 0;
+            while (i < prev.size() || k < cur.size())
+            {
+                if (k == cur.size() || (i < prev.size() && prev[i] < cur[k]))
+                    removed[b].push_back(prev[i++]);
+                else if (i == prev.size() || cur[k] < prev[i])
+                    added[b].push_back(cur[k++]);
+                else
+                    ++i, ++k;
+            }
+            fromPrevious[b] = removed[b].size() + added[b].size() < cur.size();
+        }
+
+#ifdef VECTOR
+        vec_t      acc[NumRegs];
+        psqt_vec_t psqt[NumPsqtRegs];
+
+        for (IndexType j = 0; j < HalfDimensions / TileHeight; ++j)
+        {
+            for (int b = 0; b < count; ++b)
+            {
+                const auto& toAdd = fromPrevious[b] ? added[b] : active[b];
+
+                if (fromPrevious[b])
+                {
+                    auto tileIn = reinterpret_cast<const vec_t*>(
+                      &(pos[b - 1]->state()->*accPtr).accumulation[Perspective][j * TileHeight]);
+                    for (IndexType k = 0; k < NumRegs; ++k)
+                        acc[k] = vec_load(&tileIn[k]);
+
+                    for (const auto index : removed[b])
+                    {
+                        const IndexType offset = HalfDimensions * index + j * TileHeight;
+                        auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                        for (IndexType k = 0; k < NumRegs; ++k)
+                            acc[k] = vec_sub_16(acc[k], column[k]);
+                    }
+                }
+                else
+                {
+                    auto biasesTile = reinterpret_cast<const vec_t*>(&biases[j * TileHeight]);
+                    for (IndexType k = 0; k < NumRegs; ++k)
+                        acc[k] = biasesTile[k];
+                }
+
+                for (const auto index : toAdd)
+                {
+                    const IndexType offset = HalfDimensions * index + j * TileHeight;
+                    auto            column = reinterpret_cast<const vec_t*>(&weights[offset]);
+                    for (IndexType k = 0; k < NumRegs; ++k)
+                        acc[k] = vec_add_16(acc[k], column[k]);
+                }
+
+                auto tileOut = reinterpret_cast<vec_t*>(
+                  &(pos[b]->state()->*accPtr).accumulation[Perspective][j * TileHeight]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    vec_store(&tileOut[k], acc[k]);
+            }
+        }
+
+        for (IndexType j = 0; j < PSQTBuckets / PsqtTileHeight; ++j)
+        {
+            for (int b = 0; b < count; ++b)
+            {
+                const auto& toAdd = fromPrevious[b] ? added[b] : active[b];
+
+                if (fromPrevious[b])
+                {
+                    auto tileIn = reinterpret_cast<const psqt_vec_t*>(
+                      &(pos[b - 1]->state()->*accPtr).psqtAccumulation[Perspective][j * PsqtTileHeight]);
+                    for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                        psqt[k] = vec_load_psqt(&tileIn[k]);
+
+                    for (const auto index : removed[b])
+                    {
+                        const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+                        auto columnPsqt = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+                        for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                            psqt[k] = vec_sub_psqt_32(psqt[k], columnPsqt[k]);
+                    }
+                }
+                else
+                    for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                        psqt[k] = vec_zero_psqt();
+
+                for (const auto index : toAdd)
+                {
+                    const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+                    auto columnPsqt        = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+                    for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                        psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
+                }
+
+                auto tileOut = reinterpret_cast<psqt_vec_t*>(
+                  &(pos[b]->state()->*accPtr).psqtAccumulation[Perspective][j * PsqtTileHeight]);
+                for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+                    vec_store_psqt(&tileOut[k], psqt[k]);
+            }
+        }
+#else
+        for (int b = 0; b < count; ++b)
+        {
+            auto& accumulator = pos[b]->state()->*accPtr;
+
+            if (fromPrevious[b])
+            {
+                const auto& prev = pos[b - 1]->state()->*accPtr;
+                std::memcpy(accumulator.accumulation[Perspective], prev.accumulation[Perspective],
+                            HalfDimensions * sizeof(BiasType));
+                for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                    accumulator.psqtAccumulation[Perspective][k] =
+                      prev.psqtAccumulation[Perspective][k];
+
+                for (const auto index : removed[b])
+                {
+                    const IndexType offset = HalfDimensions * index;
+                    for (IndexType j = 0; j < HalfDimensions; ++j)
+                        accumulator.accumulation[Perspective][j] -= weights[offset + j];
+                    for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                        accumulator.psqtAccumulation[Perspective][k] -=
+                          psqtWeights[index * PSQTBuckets + k];
+                }
+            }
+            else
+            {
+                std::memcpy(accumulator.accumulation[Perspective], biases,
+                            HalfDimensions * sizeof(BiasType));
+                for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                    accumulator.psqtAccumulation[Perspective][k] = 0;
+            }
+
+            for (const auto index : fromPrevious[b] ? added[b] : active[b])
+            {
+                const IndexType offset = HalfDimensions * index;
+                for (IndexType j = 0; j < HalfDimensions; ++j)
+                    accumulator.accumulation[Perspective][j] += weights[offset + j];
+                for (std::size_t k = 0; k < PSQTBuckets; ++k)
+                    accumulator.psqtAccumulation[Perspective][k] +=
+                      psqtWeights[index * PSQTBuckets + k];
+            }
+        }
+#endif
+    }
+
+    template<Color Perspective>
+    void hint_common_access_for_perspective(const Position& pos, Cache* cache) const {
 
         // Works like update_accumulator, but performs less work.
         // Updates ONLY the accumulator for pos.
@@ -675,12 +988,14 @@ class FeatureTransformer {
             StateInfo* states_to_update[2] = {pos.state(), nullptr};
             update_accumulator_incremental<Perspective, 2>(pos, oldest_st, states_to_update);
         }
+        else if (cache)
+            update_accumulator_refresh_cache<Perspective>(pos, *cache);
         else
             update_accumulator_refresh<Perspective>(pos);
     }
 
     template<Color Perspective>
-    void update_accumulator(const Position& pos) const {
+    void update_accumulator(const Position& pos, Cache* cache) const {
 
         auto [oldest_st, next] = try_find_computed_accumulator<Perspective>(pos);
 
@@ -699,10 +1014,10 @@ class FeatureTransformer {
 
             update_accumulator_incremental<Perspective, 3>(pos, oldest_st, states_to_update);
         }
+        else if (cache)
+            update_accumulator_refresh_cache<Perspective>(pos, *cache);
         else
-        {
             update_accumulator_refresh<Perspective>(pos);
-        }
     }
 
     alignas(CacheLineSize) BiasType biases[HalfDimensions];
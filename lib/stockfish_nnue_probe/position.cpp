@@ -103,6 +103,54 @@ Position& Position::set(const int pieces[], const int squares[], int pieceAmount
     return *this;
 }
 
+// Initializes the position from color and piece type bitboards (pawn to king, without
+// ALL_PIECES). Meant to be called repeatedly on the same objects: only the squares
+// occupied by the previous position are cleared and the StateInfo is not wiped, just
+// the fields the evaluation reads are reset.
+Position& Position::set(const Bitboard byColor[], const Bitboard byType[], bool side, int rule50, StateInfo* si) {
+
+    for (Bitboard b = byTypeBB[ALL_PIECES]; b;)
+        board[pop_lsb(b)] = NO_PIECE;
+
+    std::memset(pieceCount, 0, sizeof(pieceCount));
+
+    byColorBB[WHITE]     = byColor[WHITE];
+    byColorBB[BLACK]     = byColor[BLACK];
+    byTypeBB[ALL_PIECES] = byColor[WHITE] | byColor[BLACK];
+
+    st                         = si;
+    st->previous               = nullptr;
+    st->rule50                 = rule50;
+    st->nonPawnMaterial[WHITE] = st->nonPawnMaterial[BLACK] = VALUE_ZERO;
+
+    st->accumulatorBig.computed[WHITE]   = st->accumulatorBig.computed[BLACK]   = false;
+    st->accumulatorSmall.computed[WHITE] = st->accumulatorSmall.computed[BLACK] = false;
+
+    for (PieceType pt = PAWN; pt <= KING; ++pt)
+    {
+        byTypeBB[pt] = byType[pt - 1];
+
+        for (Color c : {WHITE, BLACK})
+        {
+            const Piece pc = make_piece(c, pt);
+            Bitboard    b  = byTypeBB[pt] & byColorBB[c];
+
+            pieceCount[pc] = popcount(b);
+            pieceCount[make_piece(c, ALL_PIECES)] += pieceCount[pc];
+            if (pt != PAWN && pt != KING)
+                st->nonPawnMaterial[c] += pieceCount[pc] * PieceValue[pc];
+
+            while (b)
+                board[pop_lsb(b)] = pc;
+        }
+    }
+
+    sideToMove = side ? WHITE : BLACK;
+    gamePly    = 0;
+
+    return *this;
+}
+
 // Initializes the position object with the given FEN string.
 // This function is not very robust - make sure that input FENs are correct,
 // this is assumed to be the responsibility of the GUI.
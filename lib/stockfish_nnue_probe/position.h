@@ -87,6 +87,7 @@ class Position {
     Position&   set(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50, StateInfo* si);
     Position&   set(const int pieceBoard[], bool side, int rule50, StateInfo* si);
     Position&   set(const std::string& fenStr, StateInfo* si);
+    Position&   set(const Bitboard byColor[], const Bitboard byType[], bool side, int rule50, StateInfo* si);
 
     // Position representation
     Bitboard pieces(PieceType pt = ALL_PIECES) const;
@@ -1,14 +1,118 @@
-#include "probe.h"
+#include "probe_backend.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "bitboard.h"
 #include "position.h"
 #include "evaluate.h"
+#include "misc.h"
+#include "nnue/evaluate_nnue.h"
 #include "nnue/nnue_architecture.h"
 
 namespace Stockfish {
 
     namespace Probe {
 
-        void init( const char *bigNetFile, const char *smallNetFile) {
+        namespace {
+
+            class ProbeImpl final : public ProbeBackend::Backend {
+               public:
+                const char* name() const override { return Eval::NNUE::SimdName; }
+
+                void init(const char* bigNetFile, const char* smallNetFile, const char* blobDir) override;
+
+                int eval(const char* fen) override;
+                int eval(const int pieceBoard[], bool side, int rule50) override;
+                int eval(const int pieces[],
+                         const int squares[],
+                         int       pieceAmount,
+                         bool      side,
+                         int       rule50) override;
+
+                ProbeBackend::FirstLayerBench
+                bench_first_layer(const char* const fens[], int count, int iterations) override;
+
+                ProbeBackend::Scratch*   new_scratch() override;
+                ProbeBackend::Evaluator* new_evaluator() override;
+
+                void* aligned_large_pages_alloc(std::size_t size) override {
+                    return Stockfish::aligned_large_pages_alloc(size);
+                }
+                void aligned_large_pages_free(void* mem) override {
+                    Stockfish::aligned_large_pages_free(mem);
+                }
+                const char* large_pages_kind(const void* mem) override {
+                    return Stockfish::large_pages_kind(mem);
+                }
+                std::size_t huge_page_bytes(const void* mem, std::size_t size) override {
+                    return Stockfish::huge_page_bytes(mem, size);
+                }
+            };
+
+            class alignas(Eval::NNUE::CacheLineSize) ScratchImpl final : public ProbeBackend::Scratch {
+               public:
+                int eval(const std::uint64_t byColor[],
+                         const std::uint64_t byType[],
+                         bool                side,
+                         int                 rule50) override;
+
+                void eval(const ProbeBackend::Bitboards positions[], int count, int out[]) override;
+
+               private:
+                struct Batch {
+                    StateInfo st[Eval::NNUE::MaxBatchSize];
+                    Position  pos[Eval::NNUE::MaxBatchSize];
+                };
+
+                StateInfo st;
+                Position  pos;
+
+                // Allocated by the first batched evaluation
+                std::unique_ptr<Batch> batch;
+
+                std::unique_ptr<Eval::NNUE::AccumulatorCaches> caches{
+                  new Eval::NNUE::AccumulatorCaches()};
+            };
+
+            class EvaluatorImpl final : public ProbeBackend::Evaluator {
+               public:
+                EvaluatorImpl();
+
+                void set(const int pieceBoard[], bool side, int rule50) override;
+                void set(const std::uint64_t byColor[],
+                         const std::uint64_t byType[],
+                         bool                side,
+                         int                 rule50) override;
+
+                void push() override;
+                void commit(bool side, int rule50) override;
+                void pop() override;
+
+                void put_piece(int piece, int square) override;
+                void remove_piece(int piece, int square) override;
+
+                int eval() const override;
+                int psqt() const override;
+
+               private:
+                static constexpr int MaxPly = ProbeBackend::MaxPly;
+
+                std::unique_ptr<Position>                      pos;
+                std::unique_ptr<StateInfo[]>                   states;
+                std::unique_ptr<Eval::NNUE::AccumulatorCaches> caches;
+                int                                            ply       = 0;
+                bool                                           recording = false;
+            };
+        }
+
+        void ProbeImpl::init(const char* bigNetFile, const char* smallNetFile, const char* blobDir) {
             Bitboards::init();
 
             std::unordered_map<Eval::NNUE::NetSize, Eval::EvalFile> evalFiles = {
@@ -16,16 +120,17 @@ namespace Stockfish {
                     {Eval::NNUE::Small, {"EvalFileSmall", smallNetFile, "None", ""}}
             };
 
-            evalFiles = Eval::NNUE::load_networks("", evalFiles);
+            evalFiles = Eval::NNUE::load_networks("", evalFiles, blobDir ? blobDir : "");
 
             for (auto &[netSize, evalFile]: evalFiles) {
                 std::cout << "Option: " << evalFile.optionName << std::endl; // Print other members similarly
                 std::cout << "Name: " << evalFile.defaultName << std::endl;
+                std::cout << "Memory: " << Eval::NNUE::memory_info(netSize) << std::endl;
                 std::cout << std::endl;
             }
         }
 
-        int eval(const char *fen) {
+        int ProbeImpl::eval(const char* fen) {
             Position pos;
             StateListPtr states(new std::deque<StateInfo>(1));
 
@@ -35,7 +140,7 @@ namespace Stockfish {
             return eval;
         }
 
-        int eval(const int pieceBoard[], bool side, int rule50) {
+        int ProbeImpl::eval(const int pieceBoard[], bool side, int rule50) {
             Position pos;
             StateListPtr states(new std::deque<StateInfo>(1));
 
@@ -45,7 +150,7 @@ namespace Stockfish {
             return eval;
         }
 
-        int eval(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50) {
+        int ProbeImpl::eval(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50) {
             Position pos;
             StateListPtr states(new std::deque<StateInfo>(1));
 
@@ -54,5 +159,190 @@ namespace Stockfish {
 
             return eval;
         }
+
+        ProbeBackend::FirstLayerBench
+        ProbeImpl::bench_first_layer(const char* const fens[], int count, int iterations) {
+            std::deque<StateInfo>        states(count);
+            std::vector<Position>        positions(count);
+            std::vector<const Position*> pointers(count);
+
+            for (int i = 0; i < count; ++i)
+            {
+                positions[i].set(fens[i], &states[i]);
+                pointers[i] = &positions[i];
+            }
+
+            const auto b = Eval::NNUE::bench_first_layer(pointers.data(), count, iterations);
+            return {b.nnzRatio, b.sparseNs, b.denseNs, b.identical};
+        }
+
+        ProbeBackend::Scratch* ProbeImpl::new_scratch() { return new ScratchImpl(); }
+
+        ProbeBackend::Evaluator* ProbeImpl::new_evaluator() { return new EvaluatorImpl(); }
+
+        // The copy of the library this file is compiled into, see probe_backend.h.
+        ProbeBackend::Backend& backend() {
+            static ProbeImpl impl;
+            return impl;
+        }
+
+        int ScratchImpl::eval(const std::uint64_t byColor[],
+                              const std::uint64_t byType[],
+                              bool                side,
+                              int                 rule50) {
+            pos.set(byColor, byType, side, rule50, &st);
+            return Eval::evaluate(pos, caches.get());
+        }
+
+        void ScratchImpl::eval(const ProbeBackend::Bitboards positions[], int count, int out[]) {
+            if (!batch)
+                batch.reset(new Batch());
+
+            for (int start = 0; start < count; start += Eval::NNUE::MaxBatchSize)
+            {
+                const int       n = std::min(count - start, Eval::NNUE::MaxBatchSize);
+                const Position* chunk[Eval::NNUE::MaxBatchSize];
+                Value           values[Eval::NNUE::MaxBatchSize];
+
+                for (int i = 0; i < n; ++i)
+                {
+                    const ProbeBackend::Bitboards& p = positions[start + i];
+                    batch->pos[i].set(p.byColor, p.byType, p.side, p.rule50, &batch->st[i]);
+                    chunk[i] = &batch->pos[i];
+                }
+
+                Eval::evaluate(chunk, n, values);
+
+                for (int i = 0; i < n; ++i)
+                    out[start + i] = values[i];
+            }
+        }
+
+        EvaluatorImpl::EvaluatorImpl() :
+            pos(new Position()),
+            states(new StateInfo[MaxPly]),
+            caches(new Eval::NNUE::AccumulatorCaches()) {}
+
+        void EvaluatorImpl::set(const int pieceBoard[], bool side, int rule50) {
+            ply       = 0;
+            recording = false;
+            pos->set(pieceBoard, side, rule50, &states[0]);
+        }
+
+        void EvaluatorImpl::set(const std::uint64_t byColor[],
+                                const std::uint64_t byType[],
+                                bool                side,
+                                int                 rule50) {
+            ply       = 0;
+            recording = false;
+            pos->set(byColor, byType, side, rule50, &states[0]);
+        }
+
+        // Starts a new ply on top of the current one. The accumulators are not
+        // touched here, they are brought up to date lazily by the next eval().
+        void EvaluatorImpl::push() {
+            assert(ply + 1 < MaxPly);
+
+            StateInfo* prev = &states[ply];
+            StateInfo* st   = &states[++ply];
+
+            std::memcpy(st, prev, offsetof(StateInfo, key));
+            st->previous                         = prev;
+            st->accumulatorBig.computed[WHITE]   = false;
+            st->accumulatorBig.computed[BLACK]   = false;
+            st->accumulatorSmall.computed[WHITE] = false;
+            st->accumulatorSmall.computed[BLACK] = false;
+            st->dirtyPiece.dirty_num             = 0;
+            st->dirtyPiece.piece[0]              = NO_PIECE;
+
+            pos->st   = st;
+            recording = true;
+        }
+
+        void EvaluatorImpl::commit(bool side, int rule50) {
+            StateInfo* st  = pos->st;
+            DirtyPiece& dp = st->dirtyPiece;
+
+            pos->sideToMove = side ? WHITE : BLACK;
+            st->rule50      = rule50;
+            recording       = false;
+
+            // The feature set expects the moved piece first, as that is where it looks
+            // for a king move that forces a refresh. Captures are reported before it.
+            const Color us = ~pos->sideToMove;
+            for (int i = 0; i < dp.dirty_num; ++i)
+                if (color_of(dp.piece[i]) == us && dp.from[i] != SQ_NONE)
+                {
+                    std::swap(dp.piece[0], dp.piece[i]);
+                    std::swap(dp.from[0], dp.from[i]);
+                    std::swap(dp.to[0], dp.to[i]);
+                    break;
+                }
+        }
+
+        void EvaluatorImpl::pop() {
+            assert(ply > 0);
+
+            pos->st         = &states[--ply];
+            pos->sideToMove = ~pos->sideToMove;
+            recording       = false;
+        }
+
+        void EvaluatorImpl::put_piece(int piece, int square) {
+            const Piece  pc = Piece(piece);
+            const Square s  = Square(square);
+
+            pos->put_piece(pc, s);
+            if (!recording)
+                return;
+
+            StateInfo* st = pos->st;
+            if (type_of(pc) != PAWN && type_of(pc) != KING)
+                st->nonPawnMaterial[color_of(pc)] += PieceValue[pc];
+
+            // A piece put back down after being lifted in the same move is a single
+            // from -> to change.
+            DirtyPiece& dp = st->dirtyPiece;
+            for (int i = 0; i < dp.dirty_num; ++i)
+                if (dp.piece[i] == pc && dp.to[i] == SQ_NONE)
+                {
+                    dp.to[i] = s;
+                    return;
+                }
+
+            assert(dp.dirty_num < 3);
+            dp.piece[dp.dirty_num] = pc;
+            dp.from[dp.dirty_num]  = SQ_NONE;
+            dp.to[dp.dirty_num]    = s;
+            dp.dirty_num++;
+        }
+
+        void EvaluatorImpl::remove_piece(int piece, int square) {
+            const Piece  pc = Piece(piece);
+            const Square s  = Square(square);
+
+            pos->remove_piece(s);
+            if (!recording)
+                return;
+
+            StateInfo* st = pos->st;
+            if (type_of(pc) != PAWN && type_of(pc) != KING)
+                st->nonPawnMaterial[color_of(pc)] -= PieceValue[pc];
+
+            DirtyPiece& dp = st->dirtyPiece;
+            assert(dp.dirty_num < 3);
+            dp.piece[dp.dirty_num] = pc;
+            dp.from[dp.dirty_num]  = s;
+            dp.to[dp.dirty_num]    = SQ_NONE;
+            dp.dirty_num++;
+        }
+
+        int EvaluatorImpl::eval() const {
+            return Eval::evaluate(*pos, caches.get());
+        }
+
+        int EvaluatorImpl::psqt() const {
+            return Eval::evaluate_psqt(*pos, caches.get());
+        }
     }
 }
\ No newline at end of file
@@ -1,13 +1,124 @@
 #ifndef STOCKFISH_PROBE_H
 #define STOCKFISH_PROBE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "probe_backend.h"
+
 namespace Stockfish {
     namespace Probe {
-        void init(const char*, const char*);
+        // With a blobDir, the decoded nets are also kept there as a memory-mappable file
+        // per net and instruction set, so that later processes map them instead of
+        // decoding them. Blobs not made from the same net, or damaged, are rewritten.
+        void init(const char* bigNetFile, const char* smallNetFile, const char* blobDir = nullptr);
+
+        // Instruction set of the NNUE kernels picked for this CPU, e.g. "avx2".
+        const char* simd();
+
+        // Large page memory as the library allocates its networks: on Linux explicit huge
+        // pages from the hugetlbfs pool (vm.nr_hugepages) if any are reserved, else 2 MB
+        // aligned memory advised to use transparent huge pages. Not zeroed. Free it with
+        // aligned_large_pages_free().
+        void* aligned_large_pages_alloc(std::size_t size);
+        void  aligned_large_pages_free(void* mem);
+        // How memory from aligned_large_pages_alloc() is backed, e.g. "hugetlbfs"
+        const char* large_pages_kind(const void* mem);
+        // Bytes of [mem, mem + size) that /proc/self/smaps reports as backed by huge pages of
+        // any kind, anonymous, shared memory, file or hugetlbfs. 0 where unknown.
+        std::size_t huge_page_bytes(const void* mem, std::size_t size);
 
         int eval(const char *fen);
         int eval(const int pieceBoard[], bool side, int rule50);
         int eval(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50);
+
+        using FirstLayerBench = ProbeBackend::FirstLayerBench;
+
+        // Times the first hidden layer of the big net on the given positions, through the
+        // kernel that skips all-zero blocks of 4 inputs and through one that multiplies
+        // every block. Reports the share of nonzero blocks, the nanoseconds per propagate
+        // of each kernel and whether they agreed on every output. Needs init() first.
+        FirstLayerBench bench_first_layer(const char* const fens[], int count, int iterations);
+
+        // Caller-owned, cache-aligned position and state for eval(byColor, byType, ...).
+        // Allocated once and reused, so that evaluating does no heap or string work.
+        // Like an Evaluator, it keeps a refresh cache per king square, so consecutive
+        // evaluations of similar positions only pay for the pieces that differ.
+        class Scratch {
+           public:
+            Scratch();
+            ~Scratch();
+            Scratch(const Scratch&)            = delete;
+            Scratch& operator=(const Scratch&) = delete;
+
+           private:
+            friend int  eval(const std::uint64_t[], const std::uint64_t[], bool, int, Scratch&);
+            friend void eval(const ProbeBackend::Bitboards[], int, int[], Scratch&);
+
+            std::unique_ptr<ProbeBackend::Scratch> impl;
+        };
+
+        // byColor holds the white and black occupancy, byType the pawn, knight, bishop,
+        // rook, queen and king bitboards, with bit 0 mapped to A1 and bit 63 to H8.
+        int eval(const std::uint64_t byColor[],
+                 const std::uint64_t byType[],
+                 bool                side,
+                 int                 rule50,
+                 Scratch&            scratch);
+
+        using Bitboards = ProbeBackend::Bitboards;
+
+        // Evaluates count positions into out[]. Weight columns the positions share, as
+        // siblings of one parent do, are fetched once per batch rather than once per
+        // position, which makes this much faster than count single evaluations.
+        void eval(const Bitboards positions[], int count, int out[], Scratch& scratch);
+
+        // Keeps a stack of NNUE accumulators in sync with an external board, so that
+        // an evaluation only pays for the pieces changed since the last computed
+        // accumulator instead of refreshing every feature. One Evaluator per thread.
+        //
+        // Usage: set() the root position, then for every move call push(), report the
+        // changed pieces with put_piece()/remove_piece() and finish with commit().
+        // pop() takes back the last push(); piece updates made after a pop() (while the
+        // caller restores its own board) only update the piece placement.
+        // Pieces and squares use the same encoding as eval(pieceBoard, ...).
+        // Positions whose accumulator cannot be updated incrementally, e.g. after a king
+        // move, are refreshed from a per-king-square cache of earlier refreshes.
+        // Loading other networks with init() leaves existing Evaluators with stale caches.
+        class Evaluator {
+           public:
+            static constexpr int MaxPly = ProbeBackend::MaxPly;
+
+            Evaluator();
+            ~Evaluator();
+            Evaluator(const Evaluator&)            = delete;
+            Evaluator& operator=(const Evaluator&) = delete;
+
+            void set(const int pieceBoard[], bool side, int rule50) {
+                impl->set(pieceBoard, side, rule50);
+            }
+            void set(const std::uint64_t byColor[], const std::uint64_t byType[], bool side, int rule50) {
+                impl->set(byColor, byType, side, rule50);
+            }
+
+            void push() { impl->push(); }
+            void commit(bool side, int rule50) { impl->commit(side, rule50); }
+            void pop() { impl->pop(); }
+
+            void put_piece(int piece, int square) { impl->put_piece(piece, square); }
+            void remove_piece(int piece, int square) { impl->remove_piece(piece, square); }
+
+            int eval() const { return impl->eval(); }
+
+            // Estimate of eval() from the PSQT part of the network only, for deciding
+            // whether the full evaluation is needed. It updates the accumulators on the
+            // way, so a following eval() of the same position only runs the layers.
+            int psqt() const { return impl->psqt(); }
+
+           private:
+            std::unique_ptr<ProbeBackend::Evaluator> impl;
+        };
     }
 }
 
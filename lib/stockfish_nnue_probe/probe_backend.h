@@ -0,0 +1,90 @@
+#ifndef PROBE_BACKEND_H
+#define PROBE_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The library can be compiled several times, once per instruction set, with
+// -DStockfish=Stockfish_<arch> keeping the copies apart. Every copy implements the
+// interfaces below, which live outside the renamed namespace, and probe_dispatch.cpp
+// forwards the public Probe API to the copy that suits the CPU it runs on.
+namespace ProbeBackend {
+    constexpr int MaxPly = 256;
+
+    // One position of a batched evaluation, laid out as in Probe::eval(byColor, byType, ...)
+    struct Bitboards {
+        std::uint64_t byColor[2];
+        std::uint64_t byType[6];
+        bool          side;
+        int           rule50;
+    };
+
+    // Result of Probe::bench_first_layer()
+    struct FirstLayerBench {
+        double nnzRatio;
+        double sparseNs;
+        double denseNs;
+        bool   identical;
+    };
+
+    class Scratch {
+       public:
+        virtual ~Scratch() = default;
+
+        virtual int eval(const std::uint64_t byColor[],
+                         const std::uint64_t byType[],
+                         bool                side,
+                         int                 rule50) = 0;
+
+        virtual void eval(const Bitboards positions[], int count, int out[]) = 0;
+    };
+
+    class Evaluator {
+       public:
+        virtual ~Evaluator() = default;
+
+        virtual void set(const int pieceBoard[], bool side, int rule50) = 0;
+        virtual void
+        set(const std::uint64_t byColor[], const std::uint64_t byType[], bool side, int rule50) = 0;
+
+        virtual void push()                        = 0;
+        virtual void commit(bool side, int rule50) = 0;
+        virtual void pop()                         = 0;
+
+        virtual void put_piece(int piece, int square)    = 0;
+        virtual void remove_piece(int piece, int square) = 0;
+
+        virtual int eval() const = 0;
+        virtual int psqt() const = 0;
+    };
+
+    class Backend {
+       public:
+        // Instruction set the copy was compiled for, e.g. "avx2".
+        virtual const char* name() const = 0;
+
+        virtual void init(const char* bigNetFile, const char* smallNetFile, const char* blobDir) = 0;
+
+        virtual int eval(const char* fen)                               = 0;
+        virtual int eval(const int pieceBoard[], bool side, int rule50) = 0;
+        virtual int
+        eval(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50) = 0;
+
+        virtual FirstLayerBench
+        bench_first_layer(const char* const fens[], int count, int iterations) = 0;
+
+        virtual Scratch*   new_scratch()   = 0;
+        virtual Evaluator* new_evaluator() = 0;
+
+        // The large page allocator of misc.h, see Probe::aligned_large_pages_alloc()
+        virtual void*       aligned_large_pages_alloc(std::size_t size)        = 0;
+        virtual void        aligned_large_pages_free(void* mem)                = 0;
+        virtual const char* large_pages_kind(const void* mem)                  = 0;
+        virtual std::size_t huge_page_bytes(const void* mem, std::size_t size) = 0;
+
+       protected:
+        ~Backend() = default;
+    };
+}
+
+#endif //PROBE_BACKEND_H
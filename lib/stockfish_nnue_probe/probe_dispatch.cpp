@@ -0,0 +1,159 @@
+#include "probe.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// PROBE_VNNI512, PROBE_AVX2 and PROBE_SSE41 tell which copies of the library the build
+// compiled into Stockfish_vnni512, Stockfish_avx2 and Stockfish_sse41 (see probe_backend.h).
+// Without any of them the library is compiled once, into Stockfish itself, with whatever
+// USE_* flags the build chose.
+#if defined(PROBE_VNNI512) || defined(PROBE_AVX2) || defined(PROBE_SSE41)
+    #define PROBE_DISPATCH
+#endif
+
+#define DECLARE_BACKEND(ns) \
+    namespace ns { \
+        namespace Probe { \
+            ProbeBackend::Backend& backend(); \
+        } \
+    }
+
+#ifdef PROBE_VNNI512
+DECLARE_BACKEND(Stockfish_vnni512)
+#endif
+#ifdef PROBE_AVX2
+DECLARE_BACKEND(Stockfish_avx2)
+#endif
+#ifdef PROBE_SSE41
+DECLARE_BACKEND(Stockfish_sse41)
+#endif
+#ifndef PROBE_DISPATCH
+DECLARE_BACKEND(Stockfish)
+#endif
+
+namespace Stockfish {
+
+    namespace Probe {
+
+        namespace {
+
+#ifdef PROBE_DISPATCH
+            struct Candidate {
+                const char* name;
+                bool        supported;
+                ProbeBackend::Backend& (*backend)();
+            };
+#endif
+
+            // Picks the widest kernels the CPU runs. NNUE_SIMD=<name> in the environment
+            // asks for a narrower copy instead, to compare them on one machine.
+            ProbeBackend::Backend& select() {
+#ifdef PROBE_DISPATCH
+                __builtin_cpu_init();
+
+                const Candidate candidates[] = {
+    #ifdef PROBE_VNNI512
+                    {"vnni512",
+                     __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+                       && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")
+                       && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx2")
+                       && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("popcnt"),
+                     Stockfish_vnni512::Probe::backend},
+    #endif
+    #ifdef PROBE_AVX2
+                    {"avx2",
+                     __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")
+                       && __builtin_cpu_supports("popcnt"),
+                     Stockfish_avx2::Probe::backend},
+    #endif
+    #ifdef PROBE_SSE41
+                    {"sse41", __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt"),
+                     Stockfish_sse41::Probe::backend},
+    #endif
+                };
+
+                const char* forced = std::getenv("NNUE_SIMD");
+                if (forced)
+                {
+                    for (const Candidate& c : candidates)
+                        if (c.supported && !std::strcmp(forced, c.name))
+                            return c.backend();
+
+                    std::cerr << "NNUE_SIMD=" << forced
+                              << " is not built in or not supported by this CPU, ignoring it"
+                              << std::endl;
+                }
+
+                for (const Candidate& c : candidates)
+                    if (c.supported)
+                        return c.backend();
+
+                std::cerr << "No NNUE kernels built for this CPU" << std::endl;
+                std::exit(EXIT_FAILURE);
+#else
+                return Stockfish::Probe::backend();
+#endif
+            }
+
+            ProbeBackend::Backend& active() {
+                static ProbeBackend::Backend& backend = select();
+                return backend;
+            }
+        }
+
+        void init(const char* bigNetFile, const char* smallNetFile, const char* blobDir) {
+            active().init(bigNetFile, smallNetFile, blobDir);
+        }
+
+        const char* simd() { return active().name(); }
+
+        void* aligned_large_pages_alloc(std::size_t size) {
+            return active().aligned_large_pages_alloc(size);
+        }
+
+        void aligned_large_pages_free(void* mem) { active().aligned_large_pages_free(mem); }
+
+        const char* large_pages_kind(const void* mem) { return active().large_pages_kind(mem); }
+
+        std::size_t huge_page_bytes(const void* mem, std::size_t size) {
+            return active().huge_page_bytes(mem, size);
+        }
+
+        int eval(const char* fen) { return active().eval(fen); }
+
+        int eval(const int pieceBoard[], bool side, int rule50) {
+            return active().eval(pieceBoard, side, rule50);
+        }
+
+        int eval(const int pieces[], const int squares[], int pieceAmount, bool side, int rule50) {
+            return active().eval(pieces, squares, pieceAmount, side, rule50);
+        }
+
+        FirstLayerBench bench_first_layer(const char* const fens[], int count, int iterations) {
+            return active().bench_first_layer(fens, count, iterations);
+        }
+
+        Scratch::Scratch() :
+            impl(active().new_scratch()) {}
+
+        Scratch::~Scratch() = default;
+
+        int eval(const std::uint64_t byColor[],
+                 const std::uint64_t byType[],
+                 bool                side,
+                 int                 rule50,
+                 Scratch&            scratch) {
+            return scratch.impl->eval(byColor, byType, side, rule50);
+        }
+
+        void eval(const Bitboards positions[], int count, int out[], Scratch& scratch) {
+            scratch.impl->eval(positions, count, out);
+        }
+
+        Evaluator::Evaluator() :
+            impl(active().new_evaluator()) {}
+
+        Evaluator::~Evaluator() = default;
+    }
+}
@@ -0,0 +1,3 @@
+#include "abdada.hpp"
+
+Abdada abdada;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*--------------------------------------------------------------------------------------------
+    Simplified ABDADA. With more than one thread, a node marks every move after its first
+    one while searching it, keyed by the position after the move. A node of another thread
+    that reaches a marked move, other than its own first move, defers it to the end of its
+    move list, when the result is usually in the transposition table. So the threads split
+    the siblings of any node between them instead of all searching the same subtree.
+    The marks have a small table of their own; a move whose slot is taken is not marked.
+--------------------------------------------------------------------------------------------*/
+class Abdada {
+   public:
+    static constexpr int SIZE = 1 << 16;
+
+    // Set between searches.
+    bool enabled = true;
+
+    bool busy(std::uint64_t key) const {
+        return slotOf(key).load(std::memory_order_relaxed) == key;
+    }
+
+    // Marks a position as being searched for as long as it lives. A key of 0 marks nothing.
+    class Mark {
+       public:
+        Mark(Abdada& abdada, std::uint64_t key) {
+            std::uint64_t free = 0;
+            std::atomic<std::uint64_t>& entry = abdada.slotOf(key);
+            if (key && entry.compare_exchange_strong(free, key, std::memory_order_relaxed)) {
+                slot = &entry;
+            }
+        }
+
+        ~Mark() {
+            if (slot) {
+                slot->store(0, std::memory_order_relaxed);
+            }
+        }
+
+        Mark(const Mark&) = delete;
+        Mark& operator=(const Mark&) = delete;
+
+       private:
+        std::atomic<std::uint64_t>* slot = nullptr;
+    };
+
+   private:
+    std::atomic<std::uint64_t>& slotOf(std::uint64_t key) { return table[key & (SIZE - 1)]; }
+    const std::atomic<std::uint64_t>& slotOf(std::uint64_t key) const {
+        return table[key & (SIZE - 1)];
+    }
+
+    std::atomic<std::uint64_t> table[SIZE] = {};
+};
+
+extern Abdada abdada;
@@ -2337,6 +2337,64 @@ class Board {
      * @return
      */
     [[nodiscard]] U64 hash() const { return key_; }
+
+    /**
+     * @brief Get the zobrist hash key after a move, without making it. The key is the
+     * one makeMove() leaves, with the default inexact enpassant square.
+     * @param move
+     * @return
+     */
+    [[nodiscard]] U64 keyAfter(const Move move) const {
+        U64 key = key_ ^ Zobrist::sideToMove();
+        if (ep_sq_ != Square::underlying::NO_SQ) key ^= Zobrist::enpassant(ep_sq_.file());
+
+        const auto piece = at(move.from());
+        const auto pt    = piece.type();
+
+        // castling rights lost by moving the king or a rook, or by losing a rook
+        auto cr = cr_;
+
+        if (at(move.to()) != Piece::NONE && move.typeOf() != Move::CASTLING) {
+            const auto captured = at(move.to());
+            key ^= Zobrist::piece(captured, move.to());
+
+            if (captured.type() == PieceType::ROOK && Rank::back_rank(move.to().rank(), ~stm_)) {
+                const auto file = CastlingRights::closestSide(move.to(), kingSq(~stm_));
+                if (cr.getRookFile(~stm_, file) == move.to().file()) cr.clear(~stm_, file);
+            }
+        }
+
+        if (pt == PieceType::KING) {
+            cr.clear(stm_);
+        } else if (pt == PieceType::ROOK && Square::back_rank(move.from(), stm_)) {
+            const auto file = CastlingRights::closestSide(move.from(), kingSq(stm_));
+            if (cr.getRookFile(stm_, file) == move.from().file()) cr.clear(stm_, file);
+        } else if (pt == PieceType::PAWN && Square::value_distance(move.to(), move.from()) == 16) {
+            if (attacks::pawn(stm_, move.to().ep_square()) & pieces(PieceType::PAWN, ~stm_)) {
+                key ^= Zobrist::enpassant(move.to().ep_square().file());
+            }
+        }
+
+        key ^= Zobrist::castling(cr_.hashIndex()) ^ Zobrist::castling(cr.hashIndex());
+
+        if (move.typeOf() == Move::CASTLING) {
+            const bool king_side = move.to() > move.from();
+            const auto rook      = at(move.to());
+
+            return key ^ Zobrist::piece(piece, move.from()) ^
+                   Zobrist::piece(piece, Square::castling_king_square(king_side, stm_)) ^
+                   Zobrist::piece(rook, move.to()) ^
+                   Zobrist::piece(rook, Square::castling_rook_square(king_side, stm_));
+        }
+
+        if (move.typeOf() == Move::ENPASSANT) {
+            key ^= Zobrist::piece(Piece(PieceType::PAWN, ~stm_), move.to().ep_square());
+        }
+
+        const auto placed = move.typeOf() == Move::PROMOTION ? Piece(move.promotionType(), stm_) : piece;
+
+        return key ^ Zobrist::piece(piece, move.from()) ^ Zobrist::piece(placed, move.to());
+    }
     [[nodiscard]] Color sideToMove() const { return stm_; }
     [[nodiscard]] Square enpassantSq() const { return ep_sq_; }
     [[nodiscard]] CastlingRights castlingRights() const { return cr_; }
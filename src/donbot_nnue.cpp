@@ -26,10 +26,15 @@
 #include "chess.hpp"
 #include "openings.hpp"
 #include "search.hpp"
+#include "evalcache.hpp"
+#include "lazyeval.hpp"
+#include "transposition.hpp"
+#include "abdada.hpp"
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <chrono>
+#include <algorithm>
 
 using namespace chess;
 
@@ -78,6 +83,12 @@ std::string getBookMove(Board& board) {
 // Global Board State
 Board board;
 
+// Search threads, set with "setoption name Threads"
+int numThreads = 8;
+
+// Where "setoption name SaveHash" and "setoption name LoadHash" keep the transposition table
+std::string hashFile = "donbot.hash";
+
 /**
  * Parses the "position" command and updates the board state.
  * @param command The full position command received from the GUI.
@@ -129,23 +140,41 @@ void processSetOption(const std::string& command) {
 
     iss >> token; // Skip "setoption"
     iss >> token; // Skip "name"
-    std::getline(iss, optionName, ' ');
 
-    size_t pos = optionName.find(" value ");
-    if (pos != std::string::npos) {
-        value = optionName.substr(pos + 7);
-        optionName = optionName.substr(0, pos);
+    // The name may contain spaces and runs until "value"
+    while (iss >> token && token != "value") {
+        if (!optionName.empty()) optionName += " ";
+        optionName += token;
     }
+    std::getline(iss >> std::ws, value);
 
     if (optionName == "Hash") {
-        int hashSize = std::stoi(value);
-        // Set hash table size
+        transTable.resize(std::max(1, std::stoi(value))); // MB, allocated by the next search
+    } else if (optionName == "HashShm") {
+        // Shared memory segment, e.g. /donbot
+        transTable.share(value == "<empty>" ? "" : value, NNUE_FILE);
+    } else if (optionName == "HashFile") {
+        hashFile = value;
+    } else if (optionName == "SaveHash") {
+        bool saved = transTable.save(hashFile, NNUE_FILE);
+        std::cout << "info string " << (saved ? "saved hash to " : "could not save hash to ")
+                  << hashFile << std::endl;
+    } else if (optionName == "LoadHash") {
+        // Replaces the table, at the size it was saved with
+        bool loaded = transTable.load(hashFile, NNUE_FILE);
+        std::cout << "info string " << (loaded ? "loaded hash from " : "could not load hash from ")
+                  << hashFile << std::endl;
     } else if (optionName == "Threads") {
-        int threads = std::stoi(value);
-        // Set number of threads
+        numThreads = std::max(1, std::stoi(value));
+    } else if (optionName == "ABDADA") {
+        abdada.enabled = (value == "true"); // Threads defer moves others are searching
     } else if (optionName == "Ponder") {
         bool ponder = (value == "true");
         // Enable or disable pondering
+    } else if (optionName == "EvalCache") {
+        evalCache.resize(std::stoi(value)); // Size in MB, 0 disables the cache
+    } else if (optionName == "LazyEvalMargin") {
+        lazyEval.margin = std::stoi(value); // Centipawns, 0 always runs the network
     } else {
         std::cerr << "Unknown option: " << optionName << std::endl;
     }
@@ -159,7 +188,6 @@ void processGo(const std::vector<std::string>& tokens) {
 
     // Default settings
     int depth = 30;
-    int numThreads = 8;
     int timeLimit = 30000; // Default to 15 seconds
     bool quiet = false;
 
@@ -181,6 +209,7 @@ void processGo(const std::vector<std::string>& tokens) {
     Time control:
     Option 1: movetime <x>
     Option 2: wtime <x> btime <x> winc <x> binc <x> movestogo <x>
+    depth <x> limits the depth under either, or under the default limit without a clock
     ---------------------------------------------------------------*/
 
     int wtime = 0, btime = 0, winc = 0, binc = 0, movestogo = 0, movetime = 0;
@@ -197,6 +226,8 @@ void processGo(const std::vector<std::string>& tokens) {
             movestogo = std::stoi(tokens[i + 1]); // Moves remaining
         } else if (tokens[i] == "movetime" && i + 1 < tokens.size()) {
             movetime = std::stoi(tokens[i + 1]); // Time per move
+        } else if (tokens[i] == "depth" && i + 1 < tokens.size()) {
+            depth = std::stoi(tokens[i + 1]); // Maximum search depth
         }
     }
 
@@ -229,6 +260,19 @@ void processGo(const std::vector<std::string>& tokens) {
 void processUci() {
     std::cout << "Engine's name: " << ENGINE_NAME << std::endl;
     std::cout << "Author:" << ENGINE_AUTHOR << std::endl;
+    std::cout << "option name Hash type spin default " << TranspositionTable::DEFAULT_MB
+              << " min 1 max " << TranspositionTable::MAX_MB << std::endl;
+    std::cout << "option name HashShm type string default <empty>" << std::endl;
+    std::cout << "option name HashFile type string default " << hashFile << std::endl;
+    std::cout << "option name SaveHash type button" << std::endl;
+    std::cout << "option name LoadHash type button" << std::endl;
+    std::cout << "option name Threads type spin default " << numThreads << " min 1 max 256"
+              << std::endl;
+    std::cout << "option name ABDADA type check default true" << std::endl;
+    std::cout << "option name EvalCache type spin default " << EvalCache::DEFAULT_MB
+              << " min 0 max 4096" << std::endl;
+    std::cout << "option name LazyEvalMargin type spin default " << LazyEval::DEFAULT_MARGIN
+              << " min 0 max 10000" << std::endl;
     std::cout << "uciok" << std::endl;
 }
 
@@ -245,6 +289,9 @@ void uciLoop() {
             std::cout << "readyok" << std::endl;
         } else if (line == "ucinewgame") {
             board = Board(); // Reset board to starting position
+            transTable.clear(numThreads); // Nothing from the last game carries over
+        } else if (line.find("setoption") == 0) {
+            processSetOption(line);
         } else if (line.find("position") == 0) {
             processPosition(line);
         } else if (line.find("go") == 0) {
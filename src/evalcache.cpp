@@ -0,0 +1,30 @@
+#include "evalcache.hpp"
+
+EvalCache evalCache;
+
+void EvalCache::resize(size_t megabytes) {
+    size_t slots = megabytes * 1024 * 1024 / sizeof(std::uint64_t);
+
+    table.reset();
+    mask = 0;
+    if (slots == 0) {
+        return;
+    }
+
+    size_t size = 1;
+    while (size * 2 <= slots) {
+        size *= 2;
+    }
+
+    table.reset(new std::atomic<std::uint64_t>[size]);
+    mask = size - 1;
+    clear();
+}
+
+void EvalCache::clear() {
+    if (table) {
+        for (size_t i = 0; i <= mask; i++) {
+            table[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "searchstats.hpp"
+
+/*--------------------------------------------------------------------------------------------
+    Evaluation cache shared by all search threads, keyed by Zobrist hash.
+    Every slot is a single 64-bit word holding the upper 48 bits of the key and the 16-bit
+    evaluation, so slots are read and written whole without locks: a race between threads
+    can only lose an entry, never return the evaluation of another position.
+--------------------------------------------------------------------------------------------*/
+class EvalCache {
+   public:
+    static constexpr int DEFAULT_MB = 16;
+
+    explicit EvalCache(size_t megabytes = DEFAULT_MB) { resize(megabytes); }
+
+    // Rounds down to a power of two number of slots, 0 disables the cache. Not thread safe.
+    void resize(size_t megabytes);
+    void clear();
+
+    // Issued at node entry so the slot is in cache by the time the evaluation is needed.
+    void prefetch(std::uint64_t key) const {
+        if (table) {
+            __builtin_prefetch(&table[key & mask]);
+        }
+    }
+
+    bool probe(std::uint64_t key, int& eval) {
+        if (!table) {
+            return false;
+        }
+        SearchStats::count(SearchStats::EVAL_PROBES);
+
+        std::uint64_t data = table[key & mask].load(std::memory_order_relaxed);
+        if ((data ^ key) >> 16) {
+            return false;
+        }
+        SearchStats::count(SearchStats::EVAL_HITS);
+        eval = static_cast<std::int16_t>(data & 0xFFFF);
+        return true;
+    }
+
+    // NNUE evaluations are clamped well inside the 16-bit range.
+    void store(std::uint64_t key, int eval) {
+        if (!table) {
+            return;
+        }
+        std::uint64_t data = (key & ~0xFFFFULL) | static_cast<std::uint16_t>(eval);
+        table[key & mask].store(data, std::memory_order_relaxed);
+    }
+
+    // Share of probes answered from the cache since searchStats was last reset.
+    double hitRate() const {
+        std::uint64_t n = searchStats.total(SearchStats::EVAL_PROBES);
+        return n ? static_cast<double>(searchStats.total(SearchStats::EVAL_HITS)) / n : 0.0;
+    }
+
+   private:
+    std::unique_ptr<std::atomic<std::uint64_t>[]> table;
+    std::uint64_t mask = 0;
+};
+
+extern EvalCache evalCache;
@@ -0,0 +1,169 @@
+#include "largepages.hpp"
+
+#include "../lib/stockfish_nnue_probe/probe.h"
+
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+constexpr size_t MB = 1024 * 1024;
+constexpr int SHARED_WAIT_MS = 1000; // For the process creating a segment to size it
+
+} // namespace
+
+void* LargePageMemory::allocate(size_t size) {
+    release();
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    mem = Stockfish::Probe::aligned_large_pages_alloc(size);
+    if (!mem) {
+        return nullptr;
+    }
+    bytes = size;
+    return mem;
+}
+
+void* LargePageMemory::mapFile(const std::string& path, size_t offset, size_t size) {
+    release();
+
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    void* mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= offset + size) {
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+    }
+    close(fd); // The mapping keeps the file open
+
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+    mem = mapped;
+    bytes = size;
+    fileMapped = true;
+    return mem;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in.seekg(offset) || !allocate(size)) {
+        return nullptr;
+    }
+    if (!in.read(static_cast<char*>(mem), size)) {
+        release();
+        return nullptr;
+    }
+    return mem;
+#endif
+}
+
+void* LargePageMemory::mapShared(const std::string& name, size_t size, bool& created) {
+    release();
+
+#if defined(__linux__)
+    // Only the process that creates the segment sizes it, the kernel zeroes it. The others
+    // wait for it to be sized, which a concurrent truncate to another size would undo.
+    created = true;
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    bool sized = false;
+    if (created) {
+        sized = ftruncate(fd, size) == 0;
+        if (!sized) {
+            shm_unlink(name.c_str());
+        }
+    } else {
+        struct stat info = {};
+        for (int waited = 0; fstat(fd, &info) == 0 && info.st_size == 0; waited++) {
+            if (waited == SHARED_WAIT_MS) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        sized = info.st_size > 0;
+        size = info.st_size;
+    }
+
+    void* mapped = MAP_FAILED;
+    if (sized) {
+        mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    madvise(mapped, size, MADV_HUGEPAGE); // Honored if /sys/kernel/mm/transparent_hugepage/shmem_enabled allows
+#endif
+    mem = mapped;
+    bytes = size;
+    shared = true;
+    return mem;
+#else
+    (void)name;
+    (void)size;
+    created = false;
+    return nullptr;
+#endif
+}
+
+void LargePageMemory::release() {
+    if (!mem) {
+        return;
+    }
+#if defined(__linux__)
+    if (fileMapped || shared) {
+        munmap(mem, bytes);
+    } else
+#endif
+    {
+        Stockfish::Probe::aligned_large_pages_free(mem);
+    }
+    mem = nullptr;
+    bytes = 0;
+    fileMapped = false;
+    shared = false;
+}
+
+std::string LargePageMemory::describe() const {
+    std::ostringstream out;
+#if defined(__linux__)
+    if (fileMapped) {
+        out << "mapped from a file, " << (bytes + MB / 2) / MB << " MB";
+        return out.str();
+    }
+    if (shared) {
+        out << "shared memory, " << (Stockfish::Probe::huge_page_bytes(mem, bytes) + MB / 2) / MB
+            << " of " << (bytes + MB / 2) / MB << " MB on huge pages";
+        return out.str();
+    }
+    out << Stockfish::Probe::large_pages_kind(mem) << ", "
+        << (Stockfish::Probe::huge_page_bytes(mem, bytes) + MB / 2) / MB << " of "
+        << (bytes + MB / 2) / MB << " MB on huge pages";
+#else
+    out << "default pages, " << (bytes + MB / 2) / MB << " MB";
+#endif
+    return out.str();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*--------------------------------------------------------------------------------------------
+    2 MB aligned memory for large tables, backed by huge pages where the OS grants
+    them, which cuts the TLB misses of random probes. On Linux explicit huge pages from
+    the hugetlbfs pool (vm.nr_hugepages) are tried first, then transparent huge pages
+    requested with madvise. Allocation follows the NNUE library's policy, through
+    Stockfish::Probe::aligned_large_pages_alloc().
+--------------------------------------------------------------------------------------------*/
+class LargePageMemory {
+   public:
+    LargePageMemory() = default;
+    ~LargePageMemory() { release(); }
+    LargePageMemory(const LargePageMemory&) = delete;
+    LargePageMemory& operator=(const LargePageMemory&) = delete;
+
+    // Releases any previous block. The new one is not zeroed, which for a large table is
+    // better done by several threads. Returns nullptr if the allocation fails.
+    void* allocate(size_t bytes);
+
+    // Releases any previous block and maps bytes of the file at path, from offset on, which
+    // must be a multiple of the page size. Pages are read from the file when first touched
+    // and writes stay private to the process. Elsewhere than on Linux the range is read
+    // into allocated memory. Returns nullptr if the file is too short or cannot be mapped.
+    void* mapFile(const std::string& path, size_t offset, size_t bytes);
+
+    // Releases any previous block and maps the named POSIX shared memory segment, which
+    // other processes mapping the same name share. The segment is created zeroed at the
+    // given size if it does not exist, which created tells, else mapped at its own size
+    // once the process creating it has sized it. It outlives the process until unlinked
+    // (rm /dev/shm/<name> on Linux). Returns nullptr where unsupported.
+    void* mapShared(const std::string& name, size_t bytes, bool& created);
+
+    void release();
+
+    void* data() const { return mem; }
+    size_t size() const { return bytes; }
+
+    // What was obtained, e.g. "transparent huge pages, 240 of 240 MB on huge pages".
+    // Only pages touched so far are counted.
+    std::string describe() const;
+
+   private:
+    void* mem = nullptr;
+    size_t bytes = 0;
+    bool fileMapped = false;
+    bool shared = false;
+};
@@ -0,0 +1,3 @@
+#include "lazyeval.hpp"
+
+LazyEval lazyEval;
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "searchstats.hpp"
+
+/*--------------------------------------------------------------------------------------------
+    Lazy stand-pat evaluation in quiescence search. Before running the network, the stand
+    pat is estimated from material and then from the network's PSQT term. When the
+    estimate is more than the margin above beta or below alpha, it decides the node
+    instead of the full evaluation. A margin of 0 always runs the full network.
+    Counts how each stand pat was decided in the thread's SearchStats slot.
+--------------------------------------------------------------------------------------------*/
+class LazyEval {
+   public:
+    static constexpr int DEFAULT_MARGIN = 2000;
+
+    enum Source { MATERIAL, PSQT, NETWORK, SOURCE_NB };
+
+    // Centipawns, set between searches.
+    int margin = DEFAULT_MARGIN;
+
+    static void record(Source source) { SearchStats::count(counterOf(source)); }
+
+    std::uint64_t count(Source source) const { return searchStats.total(counterOf(source)); }
+
+    // Full network evaluations skipped since searchStats was last reset.
+    std::uint64_t saved() const { return count(MATERIAL) + count(PSQT); }
+
+   private:
+    static SearchStats::Counter counterOf(Source source) {
+        return static_cast<SearchStats::Counter>(SearchStats::LAZY_MATERIAL + source);
+    }
+};
+
+extern LazyEval lazyEval;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "chess.hpp"
+#include "../lib/stockfish_nnue_probe/probe.h"
+
+using namespace chess;
+
+/*--------------------------------------------------------------------------------------------
+    Board that keeps the NNUE accumulators in sync with makeMove/unmakeMove.
+    chess::Board reports every piece it places or removes through placePiece/removePiece,
+    so the evaluator only has to be told where a move starts and ends. The evaluator
+    belongs to the searching thread and must outlive the board.
+--------------------------------------------------------------------------------------------*/
+class NNUEBoard : public Board {
+   public:
+    NNUEBoard(const Board& board, Stockfish::Probe::Evaluator& evaluator)
+        : Board(board), evaluator_(&evaluator) {
+        std::uint64_t byColor[2], byType[6];
+        bitboards(byColor, byType);
+        evaluator_->set(byColor, byType, sideToMove() == Color::WHITE, halfMoveClock());
+    }
+
+    NNUEBoard(const NNUEBoard&)            = delete;
+    NNUEBoard& operator=(const NNUEBoard&) = delete;
+
+    template <bool EXACT = false>
+    void makeMove(const Move move) {
+        evaluator_->push();
+        Board::makeMove<EXACT>(move);
+        evaluator_->commit(sideToMove() == Color::WHITE, halfMoveClock());
+    }
+
+    void unmakeMove(const Move move) {
+        evaluator_->pop();
+        Board::unmakeMove(move);
+    }
+
+    void makeNullMove() {
+        evaluator_->push();
+        Board::makeNullMove();
+        evaluator_->commit(sideToMove() == Color::WHITE, halfMoveClock());
+    }
+
+    void unmakeNullMove() {
+        evaluator_->pop();
+        Board::unmakeNullMove();
+    }
+
+    // NNUE evaluation from the side to move's point of view.
+    int evaluate() const { return evaluator_->eval(); }
+
+    // Cheap estimate of evaluate() from the network's PSQT term, see Probe::Evaluator::psqt().
+    int evaluatePsqt() const { return evaluator_->psqt(); }
+
+    // Occupancy per color and per piece type, in the layout Probe::eval(byColor, byType, ...)
+    // takes.
+    void bitboards(std::uint64_t byColor[2], std::uint64_t byType[6]) const {
+        byColor[0] = us(Color::WHITE).getBits();
+        byColor[1] = us(Color::BLACK).getBits();
+        for (int pt = 0; pt < 6; pt++) {
+            byType[pt] = pieces(PieceType(static_cast<PieceType::underlying>(pt))).getBits();
+        }
+    }
+
+   protected:
+    void placePiece(Piece piece, Square sq) override {
+        Board::placePiece(piece, sq);
+        evaluator_->put_piece(probePiece(piece), sq.index());
+    }
+
+    void removePiece(Piece piece, Square sq) override {
+        Board::removePiece(piece, sq);
+        evaluator_->remove_piece(probePiece(piece), sq.index());
+    }
+
+   private:
+    // chess::Piece counts 0-11 from the white pawn, the probe uses 1-6 and 9-14.
+    static int probePiece(Piece piece) {
+        if (piece == Piece::NONE) {
+            return 0;
+        }
+        int p = static_cast<int>(piece);
+        return p < 6 ? p + 1 : p + 3;
+    }
+
+    Stockfish::Probe::Evaluator* evaluator_;
+};
@@ -27,12 +27,18 @@
 #include "search.hpp"
 #include "chess.hpp"
 #include "utils.hpp"
+#include "nnue.hpp"
+#include "evalcache.hpp"
+#include "lazyeval.hpp"
+#include "transposition.hpp"
+#include "threadpool.hpp"
+#include "searchstats.hpp"
+#include "abdada.hpp"
 #include <iostream>
-#include <unordered_map>
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <omp.h> // Include OpenMP header
+#include <atomic>
 #include <chrono>
 #include <stdlib.h>
 #include <cmath>
@@ -49,44 +55,39 @@ typedef std::uint64_t U64;
 
 U64 trainingCount = 0;
 
+// NNUE accumulator stack of each searching thread
+thread_local Probe::Evaluator threadEvaluator;
 
-/*-------------------------------------------------------------------------------------------- 
-    Initialize the NNUE evaluation function.
---------------------------------------------------------------------------------------------*/
-void initializeNNUE() {
-    std::cout << "Initializing NNUE." << std::endl;
-
-    Stockfish::Probe::init("nn-b1a57edbea57.nnue", "nn-b1a57edbea57.nnue");
-}
 
 /*-------------------------------------------------------------------------------------------- 
     Constants and global variables.
 --------------------------------------------------------------------------------------------*/
 
-// Transposition table 
-const int maxTableSize = 10e6; // Maximum size of the transposition table
-
-struct tableEntry {
-    U64 hash;
-    int eval;
-    int depth;
-    Move bestMove;
-};
-std::vector<tableEntry> transpositionTable(maxTableSize); 
-std::unordered_map<U64, U64> historyTable; // History heuristic table
-
 std::chrono::time_point<std::chrono::high_resolution_clock> hardDeadline; // Search hardDeadline
 std::chrono::time_point<std::chrono::high_resolution_clock> softDeadline;
+std::atomic<bool> stopSearch{false}; // Set by the main thread when it is done or out of time, stops the helpers
+thread_local bool watchesClock = false; // Whether this thread checks hardDeadline for everyone
+thread_local int clockCountdown = 0; // Calls to searchStopped left before the next clock read
+const int CLOCK_CHECK_INTERVAL = 256; // Nodes between clock reads of the main thread
 
+thread_local std::vector<Move> previousPV; // Principal variation from the thread's previous iteration
 
-U64 nodeCount; // Node count for each thread
-U64 tableHit;
-std::vector<Move> previousPV; // Principal variation from the previous iteration
-std::vector<std::vector<Move>> killerMoves(1000); // Killer moves
-
-int globalMaxDepth = 0; // Maximum depth of current search
+thread_local int globalMaxDepth = 0; // Maximum depth of the thread's current iteration
+const int MATE_THRESHOLD = INF / 2 - 1000; // Scores beyond this are checkmates
 const int ENGINE_DEPTH = 30; // Maximum search depth for the current engine version
 
+// Whether the running search must unwind, because the main thread is done or time is up.
+// Only the main thread reads the clock, every CLOCK_CHECK_INTERVAL calls; helpers just read the flag.
+bool searchStopped() {
+    if (watchesClock && --clockCountdown <= 0) {
+        clockCountdown = CLOCK_CHECK_INTERVAL;
+        if (std::chrono::high_resolution_clock::now() >= hardDeadline) {
+            stopSearch.store(true, std::memory_order_relaxed);
+        }
+    }
+    return stopSearch.load(std::memory_order_relaxed);
+}
+
 // Basic piece values for move ordering, detection of sacrafices, etc.
 const int pieceValues[] = {
     0,    // No piece
@@ -99,31 +100,169 @@ const int pieceValues[] = {
 };
 
 /*-------------------------------------------------------------------------------------------- 
-    Transposition table lookup and clear.
+    Initialize the NNUE evaluation function. NNUE_BLOB_DIR names a directory where the
+    decoded nets are cached, so that later starts map them instead of decoding them.
 --------------------------------------------------------------------------------------------*/
-bool tableLookUp(Board& board, int depth, int& eval, Move& bestMove) {    
-    U64 hash = board.hash();
-    U64 index = hash % maxTableSize;
-    bool found = false;
+void initializeNNUE() {
+    std::cout << "Initializing NNUE." << std::endl;
+
+    Stockfish::Probe::init(NNUE_FILE, NNUE_FILE, getenv("NNUE_BLOB_DIR"));
+    std::cout << "NNUE kernels: " << Stockfish::Probe::simd() << std::endl;
+}
+
+/*-------------------------------------------------------------------------------------------- 
+    Transposition table lookup and insert. Checkmate scores count the plies from the root,
+    so they are stored as the distance from the stored position and converted back for the
+    ply the position is found at. Entries hold 16-bit scores: mates are moved to just below
+    TABLE_MATE and other scores saturate below them.
+    The static evaluation of a position in the table is returned even when its entry is too
+    shallow for the score to be used, NO_EVAL if it has none.
+--------------------------------------------------------------------------------------------*/
+const int TABLE_MATE = 32000;
+const int TABLE_MATE_THRESHOLD = TABLE_MATE - (INF / 2 - MATE_THRESHOLD);
+
+int scoreToTable(int eval, int ply) {
+    if (eval > MATE_THRESHOLD) {
+        return TABLE_MATE - (INF / 2 - (eval + ply));
+    }
+    if (eval < -MATE_THRESHOLD) {
+        return -TABLE_MATE + (INF / 2 + (eval - ply));
+    }
+    return std::clamp(eval, -TABLE_MATE_THRESHOLD, TABLE_MATE_THRESHOLD);
+}
+
+int scoreFromTable(int eval, int ply) {
+    if (eval > TABLE_MATE_THRESHOLD) {
+        return INF / 2 - (TABLE_MATE - eval) - ply;
+    }
+    if (eval < -TABLE_MATE_THRESHOLD) {
+        return -INF / 2 + (TABLE_MATE + eval) + ply;
+    }
+    return eval;
+}
+
+bool tableLookUp(Board& board, int depth, int ply, int& eval, TranspositionTable::Bound& bound, Move& bestMove, int& staticEval) {    
+    TranspositionTable::Entry entry;
+    staticEval = TranspositionTable::NO_EVAL;
 
-    tableEntry entry = transpositionTable[index];
-    if (entry.hash == hash && entry.depth >= depth) {
-        eval = entry.eval;
+    if (!transTable.probe(board.hash(), entry)) {
+        return false;
+    }
+
+    staticEval = entry.staticEval;
+    if (entry.depth >= depth) {
+        eval = scoreFromTable(entry.eval, ply);
+        bound = entry.bound;
         bestMove = entry.bestMove;
-        found = true;
+        return true;
     }
 
-    return found;
+    return false;
 }
 
-void tableInsert(Board& board, int depth, int eval, Move bestMove) {
-    U64 hash = board.hash();
-    U64 index = hash % maxTableSize;
+bool tableLookUp(Board& board, int depth, int ply, int& eval, TranspositionTable::Bound& bound, Move& bestMove) {
+    int staticEval;
+    return tableLookUp(board, depth, ply, eval, bound, bestMove, staticEval);
+}
+
+void tableInsert(Board& board, int depth, int ply, int eval, TranspositionTable::Bound bound, Move bestMove, int staticEval = TranspositionTable::NO_EVAL) {
+    transTable.store(board.hash(), depth, scoreToTable(eval, ply), bound, bestMove, staticEval);
+}
 
-    tableEntry entry = {hash, eval, depth, bestMove};
-    transpositionTable[index] = entry;
+// Bound of a search result obtained with the window (alpha, beta).
+TranspositionTable::Bound boundOf(int eval, int alpha, int beta) {
+    if (eval >= beta) {
+        return TranspositionTable::LOWER;
+    }
+    return eval <= alpha ? TranspositionTable::UPPER : TranspositionTable::EXACT;
 }
  
+/*-------------------------------------------------------------------------------------------- 
+    NNUE evaluation through the shared evaluation cache. The network scales its output by
+    the fifty-move counter, so the counter is mixed into the key.
+--------------------------------------------------------------------------------------------*/
+U64 evalCacheKey(U64 hash, std::uint32_t halfMoveClock) {
+    return hash ^ (static_cast<U64>(halfMoveClock) * 0x9E3779B97F4A7C15ULL);
+}
+
+U64 evalCacheKey(const Board& board) {
+    return evalCacheKey(board.hash(), board.halfMoveClock());
+}
+
+/*--------------------------------------------------------------------------------------------
+    Starts loading the transposition table cluster and the evaluation cache slot of the
+    position after the move, which the child node reads first, while the move is still
+    being prepared. Returns the key of that position.
+--------------------------------------------------------------------------------------------*/
+U64 prefetchChild(const Board& board, Move move) {
+    U64 key = board.keyAfter(move);
+    bool resetsClock = board.isCapture(move) || board.at<PieceType>(move.from()) == PieceType::PAWN;
+
+    transTable.prefetch(key);
+    evalCache.prefetch(evalCacheKey(key, resetsClock ? 0 : board.halfMoveClock() + 1));
+    return key;
+}
+
+// Moves shallower than this are searched at once, deferring them costs more than it saves
+const int ABDADA_DEPTH = 3;
+
+bool sharedSearch = false; // ABDADA is on and more than one thread searches
+
+int cachedEvaluate(NNUEBoard& board) {
+    U64 key = evalCacheKey(board);
+    int eval;
+
+    if (evalCache.probe(key, eval)) {
+        return eval;
+    }
+
+    eval = board.evaluate();
+    evalCache.store(key, eval);
+    return eval;
+}
+
+/*-------------------------------------------------------------------------------------------- 
+    Stand pat for quiescence search. Material, then the network's PSQT term, settle the
+    node without the full network when they are beyond alpha or beta by lazyEval.margin.
+    The score returned then is the estimate moved back by the margin, toward the window,
+    so it still bounds the real evaluation for the fail-soft search and the table. It is
+    only good as a bound, so it is not cached, and evaluated tells whether the score is the
+    network's evaluation instead.
+--------------------------------------------------------------------------------------------*/
+int lazyEvaluate(NNUEBoard& board, int alpha, int beta, bool& evaluated) {
+    U64 key = evalCacheKey(board);
+    int eval;
+
+    if (evalCache.probe(key, eval)) {
+        evaluated = true;
+        return eval;
+    }
+    evaluated = false;
+
+    int margin = lazyEval.margin;
+    if (margin > 0) {
+        int color = board.sideToMove() == Color::WHITE ? 1 : -1;
+
+        int estimate = color * materialImbalance(board);
+        if (estimate - margin >= beta || estimate + margin <= alpha) {
+            lazyEval.record(LazyEval::MATERIAL);
+            return estimate - margin >= beta ? estimate - margin : estimate + margin;
+        }
+
+        estimate = board.evaluatePsqt();
+        if (estimate - margin >= beta || estimate + margin <= alpha) {
+            lazyEval.record(LazyEval::PSQT);
+            return estimate - margin >= beta ? estimate - margin : estimate + margin;
+        }
+    }
+
+    eval = board.evaluate();
+    evalCache.store(key, eval);
+    lazyEval.record(LazyEval::NETWORK);
+    evaluated = true;
+    return eval;
+}
+
 /*-------------------------------------------------------------------------------------------- 
     Check if the move is a queen promotion.
 --------------------------------------------------------------------------------------------*/
@@ -135,15 +274,41 @@ bool isPromotion(const Move& move) {
 }
 
 /*-------------------------------------------------------------------------------------------- 
-    Update the killer moves.
+    Move ordering heuristics. Every search thread has its own tables, so they need no lock.
+    History scores quiet moves by side to move, from and to square. Killers are the last two
+    quiet moves that caused a beta cutoff at a ply.
 --------------------------------------------------------------------------------------------*/
+const int MAX_PLY = 256;
+const int HISTORY_MAX = 16384;
+const int MAX_TRIED_QUIETS = 64;
+
+thread_local int historyTable[2][64][64]; // History heuristic table
+thread_local Move killerMoves[MAX_PLY][2]; // Killer moves
+
+bool isKillerMove(const Move& move, int ply) {
+    ply = std::clamp(ply, 0, MAX_PLY - 1);
+    return killerMoves[ply][0] == move || killerMoves[ply][1] == move;
+}
+
 void updateKillerMoves(const Move& move, int ply) {
-    if (killerMoves[ply].size() < 2) {
-        killerMoves[ply].push_back(move);
-    } else {
-        killerMoves[ply][1] = killerMoves[ply][0];
-        killerMoves[ply][0] = move;
-    }
+    ply = std::clamp(ply, 0, MAX_PLY - 1);
+    killerMoves[ply][1] = killerMoves[ply][0];
+    killerMoves[ply][0] = move;
+}
+
+void clearKillerMoves() {
+    std::fill(&killerMoves[0][0], &killerMoves[0][0] + MAX_PLY * 2, Move());
+}
+
+int& historyOf(Color color, const Move& move) {
+    return historyTable[color][move.from().index()][move.to().index()];
+}
+
+// Gravity: a bonus shrinks as the score nears HISTORY_MAX, so scores stay within
+// +-HISTORY_MAX and old ones fade as new ones come in.
+void updateHistory(Color color, const Move& move, int bonus) {
+    int& entry = historyOf(color, move);
+    entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
 }
 
 /*-------------------------------------------------------------------------------------------- 
@@ -174,12 +339,7 @@ bool promotionThreatMove(Board& board, Move move) {
 /*-------------------------------------------------------------------------------------------- 
   SEE (Static Exchange Evaluation) function.
  -------------------------------------------------------------------------------------------*/
-int see(Board& board, Move move) {
-
-    #pragma omp critical
-    {
-        nodeCount++;
-    }
+int see(NNUEBoard& board, Move move) {
 
     int to = move.to().index();
     
@@ -243,7 +403,7 @@ int lateMoveReduction(Board& board, Move move, int i, int depth, int ply, bool i
     Returns a list of candidate moves ordered by priority.
 --------------------------------------------------------------------------------------------*/
 std::vector<std::pair<Move, int>> orderedMoves(
-    Board& board, 
+    NNUEBoard& board, 
     int depth, 
     int ply,
     std::vector<Move>& previousPV, 
@@ -262,22 +422,23 @@ std::vector<std::pair<Move, int>> orderedMoves(
     Color color = board.sideToMove();
     U64 hash = board.hash();
 
+    // The previous PV and the killers are looked up by the iteration's depth left, as they
+    // always were. Looking them up by ply changes the search, which needs a match to back.
+    const int orderPly = globalMaxDepth - depth;
+
     // Move ordering 1. promotion 2. captures 3. killer moves 4. hash 5. checks 6. quiet moves
     for (const auto& move : moves) {
         int priority = 0;
         bool secondary = false;
-        int moveIndex = move.from().index() * 64 + move.to().index();
-        int ply = globalMaxDepth - depth;
         bool hashMove = false;
 
         // Previous PV move > hash moves > captures/killer moves > checks > quiet moves
-        #pragma omp critical
         {
             Move tableMove;
             int tableEval;
-            if (tableLookUp(board, 0, tableEval, tableMove)) {
+            TranspositionTable::Bound tableBound;
+            if (tableLookUp(board, 0, ply, tableEval, tableBound, tableMove)) {
                 if (tableMove == move) {
-                    tableHit++;
                     priority = 8000;
                     candidatesPrimary.push_back({tableMove, priority});
                     hashMove = true;
@@ -287,11 +448,11 @@ std::vector<std::pair<Move, int>> orderedMoves(
       
         if (hashMove) continue;
         
-        if (previousPV.size() > ply && leftMost) {
-            if (previousPV[ply] == move) {
+        if (previousPV.size() > orderPly && leftMost) {
+            if (previousPV[orderPly] == move) {
                 priority = 10000; // PV move
             }
-        } else if (std::find(killerMoves[ply].begin(), killerMoves[ply].end(), move) != killerMoves[ply].end()) {
+        } else if (isKillerMove(move, orderPly)) {
             priority = 4000; // Killer moves
         } else if (isPromotion(move)) {
             priority = 6000; 
@@ -307,15 +468,12 @@ std::vector<std::pair<Move, int>> orderedMoves(
                 priority = 4000;
             } else {
                 secondary = true;
-                U64 moveIndex = move.from().index() * 64 + move.to().index();
-                #pragma omp critical
-                {
-                    if (historyTable.count(moveIndex)) {
-                        priority = 1000 + historyTable[moveIndex];
-                    } else {
-                        priority = moveScoreByTable(board, move);
-                    }
-                                            
+                // Moves that caused cutoffs come first, those that failed to fall behind
+                int history = historyOf(color, move);
+                if (history > 0) {
+                    priority = 1000 + history;
+                } else {
+                    priority = moveScoreByTable(board, move) + history;
                 }
             }
         } 
@@ -346,32 +504,67 @@ std::vector<std::pair<Move, int>> orderedMoves(
 /*-------------------------------------------------------------------------------------------- 
     Quiescence search for captures only.
 --------------------------------------------------------------------------------------------*/
-int quiescence(Board& board, int alpha, int beta) {
+int quiescence(NNUEBoard& board, int alpha, int beta, int ply) {
     
-    #pragma omp critical
-    nodeCount++;
+    evalCache.prefetch(evalCacheKey(board));
+
+    SearchStats::count(SearchStats::NODES);
+    SearchStats::count(SearchStats::QSEARCH_NODES);
+    SearchStats::reach(ply);
 
     if (knownDraw(board)) {
         return 0;
     }
 
+    /*--------------------------------------------------------------------------------------------
+        Probe the transposition table for entries of any depth, quiescence ones included, so a
+        capture sequence reached in another order is not searched again. There is no PV here,
+        so every bound that settles the window is a cutoff.
+    --------------------------------------------------------------------------------------------*/
+    Move tableMove;
+    int tableEval;
+    int tableStaticEval;
+    TranspositionTable::Bound tableBound = TranspositionTable::NONE;
+
+    SearchStats::count(SearchStats::TABLE_PROBES);
+    if (tableLookUp(board, TranspositionTable::DEPTH_QS, ply, tableEval, tableBound, tableMove, tableStaticEval)) {
+        SearchStats::count(SearchStats::TABLE_HITS);
+
+        if (tableBound == TranspositionTable::EXACT ||
+            (tableBound == TranspositionTable::LOWER && tableEval >= beta) ||
+            (tableBound == TranspositionTable::UPPER && tableEval <= alpha)) {
+            return tableEval;
+        }
+    }
+
+    const int alphaOrig = alpha;
+
     Movelist moves;
     movegen::legalmoves<movegen::MoveGenType::CAPTURE>(moves, board);
 
     int color = board.sideToMove() == Color::WHITE ? 1 : -1;
     int standPat = 0;
 
-    bool mopUp = isMopUpPhase(board);
+    // The network's evaluation, stored with every result so negamax need not evaluate again
+    int staticEval = TranspositionTable::NO_EVAL;
 
     if (isMopUpPhase(board)) {
         standPat = color * mopUpScore(board);
+    } else if (tableStaticEval != TranspositionTable::NO_EVAL) {
+        standPat = staticEval = tableStaticEval;
     } else {
-        standPat = Probe::eval(board.getFen().c_str());
+        bool evaluated;
+        standPat = lazyEvaluate(board, alpha, beta, evaluated);
+        if (evaluated) {
+            staticEval = standPat;
+        }
     }
 
+    // Fail soft, as negamax does: cutoffs return and store the score that caused them
     int bestScore = standPat;
     if (standPat >= beta) {
-        return beta;
+        tableInsert(board, TranspositionTable::DEPTH_QS, ply, standPat, TranspositionTable::LOWER, Move(), staticEval);
+        return standPat;
     }
 
     alpha = std::max(alpha, standPat);
@@ -385,7 +578,7 @@ int quiescence(Board& board, int alpha, int beta) {
         int victimValue = pieceValues[static_cast<int>(victim.type())];
         int attackerValue = pieceValues[static_cast<int>(attacker.type())];
 
-        int priority = see(board, move);
+        int priority = move == tableMove ? INF : see(board, move);
         candidateMoves.push_back({move, priority});
         
     }
@@ -394,27 +587,36 @@ int quiescence(Board& board, int alpha, int beta) {
         return a.second > b.second;
     });
 
+    Move bestMove = Move();
+
     for (const auto& [move, priority] : candidateMoves) {
+        prefetchChild(board, move);
         board.makeMove(move);
         int score = 0;
-        score = -quiescence(board, -beta, -alpha);
+        score = -quiescence(board, -beta, -alpha, ply + 1);
         board.unmakeMove(move);
 
         bestScore = std::max(bestScore, score);
-        alpha = std::max(alpha, score);
+        if (score > alpha) {
+            alpha = score;
+            bestMove = move;
+        }
 
         if (alpha >= beta) { 
-            return beta;
+            tableInsert(board, TranspositionTable::DEPTH_QS, ply, score, TranspositionTable::LOWER, move, staticEval);
+            return score;
         }
     }
 
+    tableInsert(board, TranspositionTable::DEPTH_QS, ply, bestScore, boundOf(bestScore, alphaOrig, beta), bestMove, staticEval);
+
     return bestScore;
 }
 
 /*-------------------------------------------------------------------------------------------- 
     Negamax with alpha-beta pruning.
 --------------------------------------------------------------------------------------------*/
-int negamax(Board& board, 
+int negamax(NNUEBoard& board, 
             int depth, 
             int alpha, 
             int beta, 
@@ -422,13 +624,14 @@ int negamax(Board& board,
             bool leftMost,
             int ply) {
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    if (currentTime >= hardDeadline) {
+    if (searchStopped()) {
         return 0;
     }
 
-    #pragma omp critical
-    nodeCount++;
+    evalCache.prefetch(evalCacheKey(board));
+
+    SearchStats::count(SearchStats::NODES);
+    SearchStats::reach(ply);
 
     bool mopUp = isMopUpPhase(board);
 
@@ -441,7 +644,6 @@ int negamax(Board& board,
     auto gameOverResult = board.isGameOver();
     if (gameOverResult.first != GameResultReason::NONE) {
         if (gameOverResult.first == GameResultReason::CHECKMATE) {
-            int ply = globalMaxDepth - depth;
             return -(INF/2 - ply); 
         }
         return 0;
@@ -451,42 +653,45 @@ int negamax(Board& board,
         return 0;
     }
 
-    // Probe the transposition table
+    /*--------------------------------------------------------------------------------------------
+        Probe the transposition table. A lower bound at least beta is a cutoff anywhere. Outside
+        PV nodes, so is an exact score or an upper bound at most alpha.
+    --------------------------------------------------------------------------------------------*/
     bool found = false;
-    bool found1 = false;
     Move tableMove;
     int tableEval;
-    int tableEval1;
+    int tableStaticEval;
+    TranspositionTable::Bound tableBound = TranspositionTable::NONE;
     
-    #pragma omp critical
-    {
-        if (tableLookUp(board, depth, tableEval, tableMove)) {
-            tableHit++;
-            found = true;
-        }
-
+    SearchStats::count(SearchStats::TABLE_PROBES);
+    if (tableLookUp(board, depth, ply, tableEval, tableBound, tableMove, tableStaticEval)) {
+        SearchStats::count(SearchStats::TABLE_HITS);
+        found = true;
     }
 
-    if (found && tableEval >= beta) {
+    if (found && (tableBound & TranspositionTable::LOWER) && tableEval >= beta) {
         return tableEval;
     } 
-    
-    // else if (found1 && tableEval1 >= beta + 500) {
-    //     return tableEval1;
-    // }
 
-    if (depth <= 0) {
-        int quiescenceEval = quiescence(board, alpha, beta);
-        
-        #pragma omp critical
-        {
-            tableInsert(board, 0, quiescenceEval, Move());
+    if (found && !isPV) {
+        if (tableBound == TranspositionTable::EXACT ||
+            (tableBound == TranspositionTable::UPPER && tableEval <= alpha)) {
+            return tableEval;
         }
-            
-        return quiescenceEval;
     }
 
-    int standPat = Probe::eval(board.getFen().c_str());
+    if (depth <= 0) {
+        return quiescence(board, alpha, beta, ply);
+    }
+
+    const int alphaOrig = alpha;
+
+    // Stored right away, so that a revisit after a cutoff below does not evaluate again
+    int standPat = tableStaticEval;
+    if (standPat == TranspositionTable::NO_EVAL) {
+        standPat = cachedEvaluate(board);
+        tableInsert(board, TranspositionTable::DEPTH_NONE, ply, 0, TranspositionTable::NONE, Move(), standPat);
+    }
 
     bool pruningCondition = !board.inCheck() 
                             && !endGameFlag 
@@ -544,10 +749,14 @@ int negamax(Board& board,
     int bestEval = -INF;
     int quietCount = 0;
 
+    // Quiet moves searched without a cutoff, they lose history if a later one cuts off
+    Move triedQuiets[MAX_TRIED_QUIETS];
+    int triedQuietCount = 0;
+
     /*--------------------------------------------------------------------------------------------
         Singular extension: If the hash move is much better than the other moves, extend the search.
     --------------------------------------------------------------------------------------------*/
-    if (found && depth >= 10 && ply <= globalMaxDepth - 1) {
+    if (found && (tableBound & TranspositionTable::LOWER) && depth >= 10 && ply <= globalMaxDepth - 1) {
         bool singularExtension = true;
         int singularBeta = tableEval - 50; // 80 - 80 * (!isPV) * depth / 60;
         int singularDepth = depth / 2;
@@ -572,11 +781,26 @@ int negamax(Board& board,
         }
     }
 
-    for (int i = 0; i < moves.size(); i++) {
+    // Moves another thread was searching when this node reached them, searched last
+    std::vector<int> deferred;
+
+    for (int k = 0; k < moves.size() + deferred.size(); k++) {
+
+        bool deferredMove = k >= moves.size();
+        int i = deferredMove ? deferred[k - moves.size()] : k;
 
         Move move = moves[i].first;
         std::vector<Move> childPV;
 
+        U64 childKey = prefetchChild(board, move);
+
+        bool splitMove = sharedSearch && i > 0 && depth >= ABDADA_DEPTH;
+        if (splitMove && !deferredMove && abdada.busy(childKey)) {
+            deferred.push_back(i);
+            continue;
+        }
+        Abdada::Mark busy(abdada, splitMove ? childKey : 0);
+
         bool isCapture = board.isCapture(move);
         bool inCheck = board.inCheck();
         bool isPromo = isPromotion(move);
@@ -664,31 +888,69 @@ int negamax(Board& board,
         bestEval = std::max(bestEval, eval);
         alpha = std::max(alpha, eval);
 
+        bool quietMove = !board.isCapture(move) && !isCheck;
+
         if (beta <= alpha) {
-            if (!board.isCapture(move) && !isCheck) {
-                U64 moveIndex = move.from().index() * 64 + move.to().index();
-                #pragma omp critical
-                {
-                    updateKillerMoves(move, ply);
-                    historyTable[moveIndex] += depth * depth;
+            if (quietMove) {
+                updateKillerMoves(move, ply);
+
+                // The quiet moves searched before this one did not cut off
+                int bonus = depth * depth;
+                Color side = board.sideToMove();
+                updateHistory(side, move, bonus);
+                for (int j = 0; j < triedQuietCount; j++) {
+                    updateHistory(side, triedQuiets[j], -bonus);
                 }
             }
             break;
         }
-    }
 
-    #pragma omp critical
-    {
-        if (PV.size() > 0) {
-            tableInsert(board, depth, bestEval, PV[0]);
+        if (quietMove && triedQuietCount < MAX_TRIED_QUIETS) {
+            triedQuiets[triedQuietCount++] = move;
         }
     }
 
+    // A search cut short returns made-up scores, which must not be stored
+    if (searchStopped()) {
+        return bestEval;
+    }
+
+    // After a fail low no move is known to be best, the stored one is kept
+    TranspositionTable::Bound bound = boundOf(bestEval, alphaOrig, beta);
+    Move bestMove = bound == TranspositionTable::UPPER || PV.empty() ? Move() : PV[0];
+    tableInsert(board, depth, ply, bestEval, bound, bestMove, standPat);
+
     return bestEval;
 }
 
+/*--------------------------------------------------------------------------------------------
+    Lazy SMP: every thread runs its own iterative deepening over the whole move list and the
+    threads only share the transposition table. Helper threads skip some depths, so that at
+    any time they spread over the depths around the main thread's instead of all searching
+    the same tree. Helper i sits out SKIP_SIZE[i] depths out of every 2 * SKIP_SIZE[i],
+    shifted by SKIP_PHASE[i].
+--------------------------------------------------------------------------------------------*/
+const int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+const int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+bool skipDepth(int threadIndex, int depth) {
+    if (threadIndex == 0) {
+        return false;
+    }
+    int i = (threadIndex - 1) % 20;
+    return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2;
+}
+
+// Outcome of one thread's iterative deepening
+struct SearchResult {
+    Move bestMove = Move();
+    int bestEval = -INF;
+    int completedDepth = 0;
+};
+
 /*-------------------------------------------------------------------------------------------- 
-    Main search function to communicate with UCI interface.
+    Iterative deepening of one search thread. Only the main thread (index 0) reports and 
+    manages the time; the helpers search until the main thread is done or maxDepth.
     Time control: 
     Soft deadline: 2x time limit
     Hard deadline: 3x time limit
@@ -700,36 +962,43 @@ int negamax(Board& board,
                   continue searching.
     - Case 3: If we are past the hard deadline, stop the search and return the best move.
 --------------------------------------------------------------------------------------------*/
-Move findBestMove(Board& board, 
-                int numThreads = 4, 
-                int maxDepth = 8, 
-                int timeLimit = 15000,
-                bool quiet = false) {
-
-
-    auto startTime = std::chrono::high_resolution_clock::now();
-    hardDeadline = startTime + 3 * std::chrono::milliseconds(timeLimit);
-    softDeadline = startTime + 2 * std::chrono::milliseconds(timeLimit);
+SearchResult iterativeDeepening(const Board& board,
+                                int threadIndex,
+                                int maxDepth,
+                                int timeLimit,
+                                bool quiet,
+                                std::chrono::time_point<std::chrono::high_resolution_clock> startTime) {
+
+    const bool mainThread = threadIndex == 0;
     bool timeLimitExceeded = false;
+    watchesClock = mainThread;
+    clockCountdown = 0;
 
-    Move bestMove = Move(); 
-    int bestEval = -INF;
-    int color = board.sideToMove() == Color::WHITE ? 1 : -1;
+    SearchResult result;
 
     std::vector<std::pair<Move, int>> moves;
-    std::vector<Move> globalPV (maxDepth);
-
-    omp_set_num_threads(numThreads);
 
     const int baseDepth = 1;
     int depth = baseDepth;
     std::vector<int> evals (2 * ENGINE_DEPTH + 1, 0);
     std::vector<Move> candidateMove (2 * ENGINE_DEPTH + 1, Move());
 
+    NNUEBoard rootBoard(board, threadEvaluator);
+    searchStats.bind(threadIndex);
+    clearKillerMoves(); // Plies count from a new root, the history carries over
+
     while (depth <= maxDepth) {
-        nodeCount = 0;
+        if (!mainThread) {
+            if (searchStopped()) {
+                break;
+            }
+            if (skipDepth(threadIndex, depth)) {
+                depth++;
+                continue;
+            }
+        }
+
         globalMaxDepth = depth;
-        tableHit = 0;
         
         // Track the best move for the current depth
         Move currentBestMove = Move();
@@ -737,10 +1006,9 @@ Move findBestMove(Board& board,
         std::vector<std::pair<Move, int>> newMoves;
         std::vector<Move> PV; // Principal variation
 
-        if (depth == baseDepth) {
-            moves = orderedMoves(board, depth, 0, previousPV, false);
+        if (moves.empty()) {
+            moves = orderedMoves(rootBoard, depth, 0, previousPV, false);
         }
-        auto iterationStartTime = std::chrono::high_resolution_clock::now();
 
         bool stopNow = false;
         int quietCount = 0;
@@ -749,8 +1017,8 @@ Move findBestMove(Board& board,
         alpha = -INF;
         beta = INF;
 
-        if (depth > 6) {
-            aspiration = evals[depth - 1];
+        if (depth > 6 && result.completedDepth > 0) {
+            aspiration = result.bestEval;
             alpha = aspiration - 100;
             beta = aspiration + 100;
         }
@@ -759,27 +1027,20 @@ Move findBestMove(Board& board,
 
             currentBestEval = -INF;
 
-            #pragma omp parallel for schedule(dynamic, 1)
             for (int i = 0; i < moves.size(); i++) {
 
-                if (stopNow) {
-                    continue;
-                }
-
                 bool leftMost = (i == 0);
 
                 Move move = moves[i].first;
                 std::vector<Move> childPV; 
-            
-                Board localBoard = board;
 
-                bool isCapture = localBoard.isCapture(move);
-                bool inCheck = localBoard.inCheck();
+                bool isCapture = rootBoard.isCapture(move);
+                bool inCheck = rootBoard.inCheck();
                 bool isPromo = isPromotion(move);
-                localBoard.makeMove(move);
-                bool isCheck = localBoard.inCheck();
-                localBoard.unmakeMove(move);
-                bool isPromoThreat = promotionThreatMove(localBoard, move);
+                rootBoard.makeMove(move);
+                bool isCheck = rootBoard.inCheck();
+                rootBoard.unmakeMove(move);
+                bool isPromoThreat = promotionThreatMove(rootBoard, move);
                 int ply = 0;
         
                 bool quiet = !isCapture && !isCheck && !isPromo && !inCheck && !isPromoThreat;
@@ -787,60 +1048,68 @@ Move findBestMove(Board& board,
                     quietCount++;
                 }
 
-
-                bool newBestFlag = false;  
-                int nextDepth = lateMoveReduction(localBoard, move, i, depth, 0, true, quietCount, leftMost);
+                int nextDepth = lateMoveReduction(rootBoard, move, i, depth, 0, true, quietCount, leftMost);
                 int eval = -INF;
 
-                localBoard.makeMove(move);
-                eval = -negamax(localBoard, nextDepth, -beta, -alpha, childPV, leftMost, ply + 1);
-                localBoard.unmakeMove(move);
-
-                // Check if the time limit has been exceeded, if so the search 
-                // has not finished. Return the best move so far.
-                if (std::chrono::high_resolution_clock::now() >= hardDeadline) {
+                /*------------------------------------------------------------------------------------
+                    PVS at the root, as in negamax: the first move gets the full window, the others
+                    a null window at the best score so far. A move that beats it is searched again
+                    at full depth, then with the full window.
+                ------------------------------------------------------------------------------------*/
+                int rootAlpha = std::max(alpha, currentBestEval);
+                bool nullWindow = i > 0;
+                int searchAlpha = nullWindow ? rootAlpha : alpha;
+                int searchBeta = nullWindow ? rootAlpha + 1 : beta;
+
+                rootBoard.makeMove(move);
+                eval = -negamax(rootBoard, nextDepth, -searchBeta, -searchAlpha, childPV, leftMost, ply + 1);
+                rootBoard.unmakeMove(move);
+
+                // If the search was stopped it has not finished. Return the best move so far.
+                if (searchStopped()) {
                     stopNow = true;
+                    break;
                 }
 
-                if (stopNow) continue;
+                if ((!nullWindow || eval > rootAlpha) && nextDepth < depth - 1) {
+                    rootBoard.makeMove(move);
+                    eval = -negamax(rootBoard, depth - 1, -searchBeta, -searchAlpha, childPV, leftMost, ply + 1);
+                    rootBoard.unmakeMove(move);
 
-                #pragma omp critical
-                {
-                    if (eval > currentBestEval) {
-                        newBestFlag = true;
+                    if (searchStopped()) {
+                        stopNow = true;
+                        break;
                     }
                 }
 
-                if (newBestFlag && nextDepth < depth - 1) {
-                    localBoard.makeMove(move);
-                    eval = -negamax(localBoard, depth - 1, -beta, -alpha, childPV, leftMost, ply + 1);
-                    localBoard.unmakeMove(move);
+                if (nullWindow && eval > rootAlpha && eval < beta) {
+                    rootBoard.makeMove(move);
+                    eval = -negamax(rootBoard, depth - 1, -beta, -rootAlpha, childPV, leftMost, ply + 1);
+                    rootBoard.unmakeMove(move);
 
-                    // Check if the time limit has been exceeded, if so the search 
-                    // has not finished. Return the best move so far.
-                    if (std::chrono::high_resolution_clock::now() >= hardDeadline) {
+                    if (searchStopped()) {
                         stopNow = true;
+                        break;
                     }
                 }
 
-                if (stopNow) continue;
-
-                #pragma omp critical
                 newMoves.push_back({move, eval});
 
-                #pragma omp critical
-                {
-                    if (eval > currentBestEval) {
-                        currentBestEval = eval;
-                        currentBestMove = move;
+                if (eval > currentBestEval) {
+                    currentBestEval = eval;
+                    currentBestMove = move;
 
-                        PV.clear();
+                    PV.clear();
+                    PV.push_back(move);
+                    for (auto& move : childPV) {
                         PV.push_back(move);
-                        for (auto& move : childPV) {
-                            PV.push_back(move);
-                        }
                     }
                 }
+
+                // Fail high, the aspiration window is widened and the moves searched again
+                if (currentBestEval >= beta) {
+                    break;
+                }
             }
 
             if (stopNow) {
@@ -863,30 +1132,40 @@ Move findBestMove(Board& board,
             break;
         }
 
-        // Update the global best move and evaluation after this depth if the time limit is not exceeded
-        bestMove = currentBestMove;
-        bestEval = currentBestEval;
+        // Update the thread's best move and evaluation after this depth if it was not stopped
+        result.bestMove = currentBestMove;
+        result.bestEval = currentBestEval;
+        result.completedDepth = depth;
 
-        // Sort the moves by evaluation for the next iteration
-        std::sort(newMoves.begin(), newMoves.end(), [](const auto& a, const auto& b) {
+        // Sort the moves by evaluation for the next iteration. Moves that failed low under the
+        // null window only have bounds, so ties keep the order they were searched in.
+        std::stable_sort(newMoves.begin(), newMoves.end(), [](const auto& a, const auto& b) {
             return a.second > b.second;
         });
 
-        #pragma omp critical
-        {
-            tableInsert(board, depth, bestEval, bestMove);
-        }
+        tableInsert(rootBoard, depth, 0, result.bestEval, TranspositionTable::EXACT, result.bestMove);
 
         moves = newMoves;
         previousPV = PV;
 
-        std::string depthStr = "depth " +  std::to_string(std::max(size_t(depth), PV.size()));
-        std::string scoreStr = "score cp " + std::to_string(bestEval);
-        std::string nodeStr = "nodes " + std::to_string(nodeCount);
-        std::string tableHitStr = "tableHit " + std::to_string(static_cast<double>(tableHit) / nodeCount);
+        if (!mainThread) {
+            if (moves.size() == 1) {
+                break;
+            }
+            depth++;
+            continue;
+        }
 
-        auto iterationEndTime = std::chrono::high_resolution_clock::now();
-        std::string timeStr = "time " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(iterationEndTime - iterationStartTime).count());
+        // Nodes and time count from the start of the search, all threads included
+        U64 nodes = searchStats.total(SearchStats::NODES);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+
+        std::string depthStr = "depth " + std::to_string(depth) + " seldepth " + std::to_string(searchStats.seldepth());
+        std::string scoreStr = "score cp " + std::to_string(result.bestEval);
+        std::string nodeStr = "nodes " + std::to_string(nodes) + " nps " + std::to_string(nodes * 1000 / std::max<U64>(elapsed, 1));
+        std::string hashfullStr = "hashfull " + std::to_string(transTable.hashfull());
+        std::string timeStr = "time " + std::to_string(elapsed);
 
 
         std::string pvStr = "pv ";
@@ -894,25 +1173,35 @@ Move findBestMove(Board& board,
             pvStr += uci::moveToUci(move) + " ";
         }
 
-        std::string analysis = "info " + depthStr + " " + scoreStr + " " +  nodeStr + " " + timeStr + " " + pvStr;
+        std::string analysis = "info " + depthStr + " " + scoreStr + " " +  nodeStr + " " + timeStr + " " + hashfullStr + " " + pvStr;
 
         if (!quiet) {
             std::cout << analysis << std::endl;
+            // Permille, like hashfull
+            std::cout << "info string tt hitrate " << searchStats.tableHitRate() << " qsearch nodes "
+                      << searchStats.total(SearchStats::QSEARCH_NODES) << std::endl;
+            std::cout << "info string evalcache hitrate "
+                      << static_cast<int>(evalCache.hitRate() * 1000) << std::endl;
+            // Full network evaluations the lazy stand pat skipped, per node
+            std::cout << "info string lazyeval saved " << lazyEval.saved() << " ("
+                      << static_cast<double>(lazyEval.saved()) / nodes << " per node), material "
+                      << lazyEval.count(LazyEval::MATERIAL) << " psqt "
+                      << lazyEval.count(LazyEval::PSQT) << " network "
+                      << lazyEval.count(LazyEval::NETWORK) << std::endl;
         }
 
         if (moves.size() == 1) {
-            return moves[0].first;
+            break;
         }
 
-
         auto currentTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count();
 
         timeLimitExceeded = duration > timeLimit;
         bool spendTooMuchTime = currentTime >= softDeadline;
 
-        evals[depth] = bestEval;
-        candidateMove[depth] = bestMove; 
+        evals[depth] = result.bestEval;
+        candidateMove[depth] = result.bestMove; 
 
         // Check for stable evaluation
         bool stableEval = true;
@@ -935,5 +1224,54 @@ Move findBestMove(Board& board,
         }
     }
 
-    return bestMove; 
-}
\ No newline at end of file
+    return result;
+}
+
+/*-------------------------------------------------------------------------------------------- 
+    Main search function to communicate with UCI interface. Runs iterativeDeepening() on 
+    numThreads threads of the thread pool; the main thread stops the helpers when it is done.
+    Below the root the threads split work with ABDADA.
+    A helper's move is played instead of the main thread's only if the helper completed a 
+    deeper iteration with a better score.
+--------------------------------------------------------------------------------------------*/
+Move findBestMove(Board& board, 
+                int numThreads = 4, 
+                int maxDepth = 8, 
+                int timeLimit = 15000,
+                bool quiet = false) {
+
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    hardDeadline = startTime + 3 * std::chrono::milliseconds(timeLimit);
+    softDeadline = startTime + 2 * std::chrono::milliseconds(timeLimit);
+
+    // The table is allocated by the first search after a size is set, and zeroed by the
+    // search threads
+    threadPool.resize(std::min(numThreads, SearchStats::MAX_THREADS));
+    if (transTable.allocate() && !quiet) {
+        std::cout << "info string hash " << transTable.megabytes() << " MB, "
+                  << transTable.describe() << std::endl;
+    }
+    transTable.newSearch();
+
+    stopSearch = false;
+    sharedSearch = abdada.enabled && threadPool.size() > 1;
+    searchStats.reset();
+
+    std::vector<SearchResult> results(threadPool.size());
+    threadPool.run([&](int threadIndex) {
+        results[threadIndex] = iterativeDeepening(board, threadIndex, maxDepth, timeLimit, quiet, startTime);
+        if (threadIndex == 0) {
+            stopSearch = true;
+        }
+    });
+
+    SearchResult best = results[0];
+    for (const auto& result : results) {
+        if (result.completedDepth > best.completedDepth && result.bestEval > best.bestEval) {
+            best = result;
+        }
+    }
+
+    return best.bestMove; 
+}
@@ -6,6 +6,7 @@ using namespace chess;
 
 // Constants
 const int INF = 100000;
+const char* const NNUE_FILE = "nn-b1a57edbea57.nnue"; // Big and small net
 
 // Function Declarations
 void initializeNNUE();
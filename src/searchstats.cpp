@@ -0,0 +1,5 @@
+#include "searchstats.hpp"
+
+SearchStats searchStats;
+
+thread_local SearchStats::Slot* SearchStats::local = &searchStats.unbound;
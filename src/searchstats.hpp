@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/*--------------------------------------------------------------------------------------------
+    Search statistics. Every search thread counts into a slot of its own, aligned to cache
+    lines, so counting a node is a relaxed load and store with no lock and no line shared
+    between cores. The eval cache and the lazy stand pat count here too. The totals are
+    summed over the slots on demand and reset only between searches. Threads that never
+    bound a slot count into a scratch slot, which no total includes.
+--------------------------------------------------------------------------------------------*/
+class SearchStats {
+   public:
+    static constexpr int MAX_THREADS = 256;
+
+    enum Counter {
+        NODES,
+        QSEARCH_NODES,
+        TABLE_PROBES,
+        TABLE_HITS,
+        EVAL_PROBES,
+        EVAL_HITS,
+        LAZY_MATERIAL, // Stand pats decided by material, then by PSQT, then by the network
+        LAZY_PSQT,
+        LAZY_NETWORK,
+        COUNTER_NB
+    };
+
+    // Makes the calling thread count into slot threadIndex, until it binds again.
+    void bind(int threadIndex) { local = &slots[threadIndex]; }
+
+    // Only the thread bound to a slot writes it, so no read-modify-write is needed.
+    static void count(Counter counter) {
+        auto& value = local->counters[counter];
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Deepest ply the calling thread has searched.
+    static void reach(int ply) {
+        if (ply > local->seldepth.load(std::memory_order_relaxed)) {
+            local->seldepth.store(ply, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint64_t total(Counter counter) const {
+        std::uint64_t sum = 0;
+        for (const auto& slot : slots) {
+            sum += slot.counters[counter].load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    int seldepth() const {
+        int deepest = 0;
+        for (const auto& slot : slots) {
+            int ply = slot.seldepth.load(std::memory_order_relaxed);
+            deepest = ply > deepest ? ply : deepest;
+        }
+        return deepest;
+    }
+
+    // Permille of table probes that found the position.
+    int tableHitRate() const {
+        std::uint64_t probes = total(TABLE_PROBES);
+        return probes ? static_cast<int>(total(TABLE_HITS) * 1000 / probes) : 0;
+    }
+
+    // Not to be called while a search runs.
+    void reset() {
+        for (auto& slot : slots) {
+            for (auto& value : slot.counters) {
+                value.store(0, std::memory_order_relaxed);
+            }
+            slot.seldepth.store(0, std::memory_order_relaxed);
+        }
+    }
+
+   private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> counters[COUNTER_NB] = {};
+        std::atomic<int> seldepth{0};
+    };
+
+    Slot slots[MAX_THREADS];
+    Slot unbound;
+    static thread_local Slot* local;
+};
+
+extern SearchStats searchStats;
@@ -0,0 +1,58 @@
+#include "threadpool.hpp"
+
+ThreadPool threadPool;
+
+void ThreadPool::resize(int threads) {
+    if (threads == size()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    quit = false;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i, jobCount);
+    }
+}
+
+void ThreadPool::run(const std::function<void(int)>& job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = job;
+        running = static_cast<int>(workers.size());
+        jobCount++;
+    }
+    wake.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return running == 0; });
+}
+
+void ThreadPool::workerLoop(int index, std::uint64_t done) {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return quit || jobCount != done; });
+        if (quit) {
+            return;
+        }
+        done = jobCount;
+        lock.unlock();
+
+        currentJob(index);
+
+        lock.lock();
+        if (--running == 0) {
+            finished.notify_one();
+        }
+    }
+}
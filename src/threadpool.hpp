@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*--------------------------------------------------------------------------------------------
+    Persistent search threads. Workers are started by resize() and sleep between jobs, so
+    their thread_local state, the NNUE accumulator stacks first of all, lives from one
+    search to the next instead of being rebuilt by every search.
+    Thread 0 is the thread that calls run(); the pool starts the others.
+--------------------------------------------------------------------------------------------*/
+class ThreadPool {
+   public:
+    ThreadPool() = default;
+    ~ThreadPool() { resize(1); }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads taking part in run(), the caller included. Not to be called during run().
+    void resize(int threads);
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Calls job(index) on every thread, index 0 on the caller, and returns once all calls
+    // have returned.
+    void run(const std::function<void(int)>& job);
+
+   private:
+    // done is the job count at start, read by resize() before run() can post a new job
+    void workerLoop(int index, std::uint64_t done);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;     // A job was posted or the workers must quit
+    std::condition_variable finished; // The last worker finished the job
+    std::function<void(int)> currentJob;
+    std::uint64_t jobCount = 0; // Jobs posted so far, a worker runs each once
+    int running = 0;            // Workers still on the current job
+    bool quit = false;
+};
+
+extern ThreadPool threadPool;
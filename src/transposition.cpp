@@ -0,0 +1,266 @@
+#include "transposition.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+TranspositionTable transTable;
+
+void TranspositionTable::resize(size_t megabytes) {
+    megabytes = std::clamp<size_t>(megabytes, 1, MAX_MB);
+
+    sizedCount = 1;
+    while (sizedCount * 2 * sizeof(Cluster) <= megabytes * 1024 * 1024) {
+        sizedCount *= 2;
+    }
+
+    memory.release();
+    clusters = nullptr;
+    clusterCount = 0;
+    generation = &ownGeneration;
+}
+
+void TranspositionTable::share(const std::string& name, const std::string& network) {
+    sharedName = name;
+    sharedNetHash = networkHash(network);
+    memory.release();
+    clusters = nullptr;
+    clusterCount = 0;
+    generation = &ownGeneration;
+}
+
+bool TranspositionTable::allocate() {
+    if (clusters) {
+        return false;
+    }
+
+    // A segment another process created keeps its size, whatever Hash says here
+    bool created = false;
+    if (!sharedName.empty() &&
+        memory.mapShared(sharedName, FILE_HEADER_BYTES + sizedCount * sizeof(Cluster), created)) {
+        auto header = static_cast<SharedHeader*>(memory.data());
+        if (created) {
+            header->file = makeHeader(sizedCount, sharedNetHash);
+            header->ready.store(1, std::memory_order_release);
+        }
+        for (int waited = 0; !header->ready.load(std::memory_order_acquire); waited++) {
+            if (waited == SHARED_WAIT_MS) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        const std::uint64_t count = header->file.clusterCount;
+        if (header->ready.load(std::memory_order_acquire) &&
+            compatible(header->file, sharedNetHash) &&
+            FILE_HEADER_BYTES + count * sizeof(Cluster) <= memory.size()) {
+            clusters = reinterpret_cast<Cluster*>(static_cast<char*>(memory.data()) +
+                                                  FILE_HEADER_BYTES);
+            clusterCount = count;
+            shift = 64 - __builtin_ctzll(count);
+            generation = &header->generation;
+            return true;
+        }
+        memory.release(); // Written by another build or for another network
+    }
+
+    for (std::uint64_t count = sizedCount; count > 1; count /= 2) {
+        clusters = static_cast<Cluster*>(memory.allocate(count * sizeof(Cluster)));
+        if (clusters) {
+            clusterCount = count;
+            shift = 64 - __builtin_ctzll(count);
+            zeroClusters();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::clear(int threads) {
+    if (!sharedName.empty()) {
+        return;
+    }
+    ownGeneration = 0;
+    if (!clusters) {
+        return;
+    }
+
+    threadPool.resize(threads);
+    zeroClusters();
+}
+
+void TranspositionTable::zeroClusters() {
+    // Each thread of the pool zeroes a contiguous chunk of clusters
+    const int threads = threadPool.size();
+    const std::uint64_t chunk = (clusterCount + threads - 1) / threads;
+
+    threadPool.run([&](int i) {
+        std::uint64_t begin = std::min(clusterCount, i * chunk);
+        std::uint64_t end = std::min(clusterCount, begin + chunk);
+        std::memset(static_cast<void*>(clusters + begin), 0, (end - begin) * sizeof(Cluster));
+    });
+}
+
+bool TranspositionTable::save(const std::string& path, const std::string& network) const {
+    if (!clusters) {
+        return false;
+    }
+
+    FileHeader header = makeHeader(clusterCount, networkHash(network));
+    header.generation = currentGeneration();
+
+    char page[FILE_HEADER_BYTES] = {};
+    std::memcpy(page, &header, sizeof(header));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(page, sizeof(page));
+    out.write(reinterpret_cast<const char*>(clusters), clusterCount * sizeof(Cluster));
+    return static_cast<bool>(out.flush());
+}
+
+bool TranspositionTable::load(const std::string& path, const std::string& network) {
+    FileHeader header;
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    if (!compatible(header, networkHash(network))) {
+        return false;
+    }
+
+    auto mapped = static_cast<Cluster*>(
+        memory.mapFile(path, FILE_HEADER_BYTES, header.clusterCount * sizeof(Cluster)));
+    if (!mapped) {
+        // The old table is gone, the next search allocates one at the size set by resize()
+        clusters = nullptr;
+        clusterCount = 0;
+        generation = &ownGeneration;
+        return false;
+    }
+
+    clusters = mapped;
+    clusterCount = sizedCount = header.clusterCount;
+    shift = 64 - __builtin_ctzll(clusterCount);
+    ownGeneration = header.generation % GENERATIONS;
+    generation = &ownGeneration;
+    return true;
+}
+
+TranspositionTable::FileHeader TranspositionTable::makeHeader(std::uint64_t clusterCount,
+                                                             std::uint64_t netHash) {
+    FileHeader header = {};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.clusterBytes = sizeof(Cluster);
+    header.clusterCount = clusterCount;
+    header.netHash = netHash;
+    return header;
+}
+
+bool TranspositionTable::compatible(const FileHeader& header, std::uint64_t netHash) {
+    return std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 &&
+           header.version == FILE_VERSION && header.clusterBytes == sizeof(Cluster) &&
+           header.netHash == netHash && header.clusterCount > 1 &&
+           (header.clusterCount & (header.clusterCount - 1)) == 0;
+}
+
+int TranspositionTable::hashfull() const {
+    if (!clusters) {
+        return 0;
+    }
+
+    std::uint64_t sampled = std::min<std::uint64_t>(1000 / ENTRIES_PER_CLUSTER, clusterCount);
+    int count = 0;
+    for (std::uint64_t i = 0; i < sampled; i++) {
+        for (const auto& word : clusters[i].data) {
+            std::uint64_t data = word.load(std::memory_order_relaxed);
+            count += data && generationOf(data) == currentGeneration();
+        }
+    }
+    return static_cast<int>(count * 1000 / (sampled * ENTRIES_PER_CLUSTER));
+}
+
+bool TranspositionTable::probe(std::uint64_t key, Entry& entry) const {
+    if (!clusters) {
+        return false;
+    }
+
+    const Cluster& cluster = clusterOf(key);
+
+    for (int i = 0; i < ENTRIES_PER_CLUSTER; i++) {
+        std::uint64_t data = cluster.data[i].load(std::memory_order_relaxed);
+        if (!data || cluster.check[i].load(std::memory_order_relaxed) != checkOf(key, data)) {
+            continue;
+        }
+        entry.bestMove = chess::Move(static_cast<std::uint16_t>(data));
+        entry.depth = depthOf(data);
+        entry.bound = static_cast<Bound>((data >> 24) & 3);
+        entry.staticEval = staticEvalOf(data);
+        entry.eval = evalOf(data);
+        return true;
+    }
+    return false;
+}
+
+void TranspositionTable::store(std::uint64_t key, int depth, int eval, Bound bound,
+                               chess::Move bestMove, int staticEval) {
+    if (!clusters) {
+        return;
+    }
+
+    Cluster& cluster = clusterOf(key);
+    int replace = -1;
+    int replaceWorth = 0;
+    std::uint64_t replaceData = 0;
+
+    // Quiescence results and bare static evaluations leave searched entries alone
+    auto searchedNow = [&](std::uint64_t data) {
+        return depth < 0 && data && depthOf(data) >= 0 && ageOf(data) == 0;
+    };
+
+    for (int i = 0; i < ENTRIES_PER_CLUSTER; i++) {
+        std::uint64_t data = cluster.data[i].load(std::memory_order_relaxed);
+        if (data && cluster.check[i].load(std::memory_order_relaxed) == checkOf(key, data)) {
+            if (bound == NONE) {
+                if (staticEvalOf(data) == NO_EVAL) {
+                    data = (data & ~(0xFFFFULL << 48)) | packStaticEval(staticEval);
+                    cluster.check[i].store(checkOf(key, data), std::memory_order_relaxed);
+                    cluster.data[i].store(data, std::memory_order_relaxed);
+                }
+                return;
+            }
+            bool deeper = bound != EXACT && depth < depthOf(data) - DEPTH_MARGIN;
+            if ((deeper && ageOf(data) == 0) || searchedNow(data)) {
+                return;
+            }
+            replace = i;
+            replaceData = data;
+            if (bestMove == chess::Move()) {
+                bestMove = chess::Move(static_cast<std::uint16_t>(data));
+            }
+            if (staticEval == NO_EVAL) {
+                staticEval = staticEvalOf(data);
+            }
+            break;
+        }
+        // Empty slots hold zero words and are worth less than any entry
+        int worth = data ? depthOf(data) - AGE_WEIGHT * ageOf(data) : -1000;
+        if (replace < 0 || worth < replaceWorth) {
+            replace = i;
+            replaceWorth = worth;
+            replaceData = data;
+        }
+    }
+
+    if (searchedNow(replaceData)) {
+        return;
+    }
+
+    std::uint64_t data = pack(depth, eval, bound, bestMove, staticEval);
+    cluster.check[replace].store(checkOf(key, data), std::memory_order_relaxed);
+    cluster.data[replace].store(data, std::memory_order_relaxed);
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "chess.hpp"
+#include "largepages.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*--------------------------------------------------------------------------------------------
+    Transposition table shared by all search threads, without locks.
+    The table is an array of 32-byte clusters, two to a cache line, holding
+    ENTRIES_PER_CLUSTER entries of 10 bytes. A position may sit in any entry of the cluster
+    its key maps to. Every entry is a 64-bit data word and a 16-bit check, the low 16 bits
+    of the key XORed with the data folded to 16 bits, written and read whole but
+    independently. An entry torn by a concurrent write fails the check but for one time in
+    65536, as does an entry of another position in the cluster. The search only compares
+    the stored move with moves it generated, so a wrong hit costs a bad cutoff at worst.
+    The number of clusters is a power of two, so the cluster of a key is picked by a
+    multiply and a shift instead of a 64-bit division. The memory is only allocated when a
+    search first needs it, so resizing before the first search costs nothing.
+    Every entry carries the generation, bumped at each search, it was last written in.
+    Entries of earlier searches are the first to go, then the shallowest.
+    A table can be saved to a file and mapped back by a later process, which then starts
+    its searches from what the saved one learned. It can also live in a named shared memory
+    segment, where engine processes on the same host read and write it as threads do. The
+    segment starts with the header of a saved table, so that processes built with another
+    entry layout or network keep a private table instead, and with the generation, which
+    the searches of every process attached bump.
+--------------------------------------------------------------------------------------------*/
+class TranspositionTable {
+   public:
+    static constexpr int DEFAULT_MB = 256;
+    static constexpr int DEPTH_MARGIN = 3;
+    static constexpr int AGE_WEIGHT = 8;
+    static constexpr int MAX_MB = 1 << 20;
+    static constexpr int ENTRIES_PER_CLUSTER = 3;
+    static constexpr int GENERATIONS = 64;
+    static constexpr std::uint32_t FILE_VERSION = 3; // Bump when the entry layout changes
+
+    // Depth of quiescence search entries, below every negamax depth, and of entries that
+    // only carry a static evaluation, below any searched depth.
+    static constexpr int DEPTH_QS = -1;
+    static constexpr int DEPTH_NONE = -127;
+
+    // Static evaluation of entries stored without one, or with one beyond 16 bits.
+    static constexpr int NO_EVAL = INT16_MIN;
+
+    // What the stored evaluation is known to be: an upper bound after a fail low, a lower
+    // bound after a fail high, or the exact value.
+    enum Bound { NONE = 0, UPPER = 1, LOWER = 2, EXACT = UPPER | LOWER };
+
+    struct Entry {
+        int eval;
+        int staticEval;
+        int depth;
+        Bound bound;
+        chess::Move bestMove;
+    };
+
+    explicit TranspositionTable(size_t megabytes = DEFAULT_MB) { resize(megabytes); }
+
+    // Sets the size, rounded down to a power of two number of clusters and clamped to
+    // [1, MAX_MB] megabytes, and frees the current table. Not thread safe.
+    void resize(size_t megabytes);
+
+    // Puts the table in the named POSIX shared memory segment from the next allocate() on,
+    // an empty name makes it private again. Only processes evaluating with the same
+    // network share a segment. Frees the current table. Not thread safe.
+    void share(const std::string& name, const std::string& network);
+
+    // Allocates the table at the size set by resize() unless it already is, in the shared
+    // segment if there is one, it can be mapped and its header matches. If the memory
+    // is not available the size is halved until it is. A private table is zeroed on the
+    // threads of threadPool. Returns whether it allocated. Not thread safe.
+    bool allocate();
+
+    // Zeroes the table on the given number of threads of threadPool, which it resizes, and
+    // restarts the generations. A shared table is left as it is, other processes may be
+    // using it. Not to be called during a search.
+    void clear(int threads = 1);
+
+    // Called before every search, so that entries of the previous ones age.
+    void newSearch() { generation->fetch_add(1, std::memory_order_relaxed); }
+
+    // Writes the table to a file, tagged with the file name of the network whose evaluations
+    // it holds, which names carry a hash of. Not thread safe. Returns false if there is no
+    // table yet or the file cannot be written.
+    bool save(const std::string& path, const std::string& network) const;
+
+    // Maps a table written by save() in place of this one, at the size it was saved with.
+    // Files of another version or network are rejected and leave the table as it is.
+    // Not thread safe.
+    bool load(const std::string& path, const std::string& network);
+
+    // Permille of the entries written in the current search, among the first 1000.
+    int hashfull() const;
+
+    // Issued before the move to the position is made, so the cluster is in cache by the
+    // time the child node probes it.
+    void prefetch(std::uint64_t key) const {
+        if (clusters) {
+            __builtin_prefetch(&clusterOf(key));
+        }
+    }
+
+    bool probe(std::uint64_t key, Entry& entry) const;
+
+    // An entry of the same position is replaced unless it is deeper by more than DEPTH_MARGIN
+    // and from the current search, which an exact score still replaces. Otherwise the entry
+    // with the lowest depth minus AGE_WEIGHT per generation of age makes room. The score and
+    // static evaluation must fit in 16 bits, the caller maps larger scores. Entries of a
+    // negative depth never replace ones of the current search searched to depth 0 or more.
+    // Without a best move or static evaluation, the ones already stored for the position
+    // are kept. A store of bound NONE, which only carries a static evaluation, only fills
+    // in that of an entry of the position.
+    void store(std::uint64_t key, int depth, int eval, Bound bound, chess::Move bestMove,
+               int staticEval);
+
+    size_t megabytes() const { return clusterCount * sizeof(Cluster) / (1024 * 1024); }
+
+    // Pages backing the table, see LargePageMemory::describe().
+    std::string describe() const { return memory.describe(); }
+
+   private:
+    // Start of a saved table, padded to a page so the clusters that follow can be mapped.
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t clusterBytes;
+        std::uint64_t clusterCount;
+        std::uint64_t netHash;
+        std::uint32_t generation;
+    };
+    static constexpr size_t FILE_HEADER_BYTES = 4096;
+    static constexpr char FILE_MAGIC[8] = {'D', 'O', 'N', 'B', 'O', 'T', 'T', 'T'};
+
+    // Start of a shared segment, in the page before the clusters. The process creating the
+    // segment writes the header, then sets ready, the others wait for it before checking it.
+    // Their searches all bump the generation, the header's one is left at 0.
+    struct SharedHeader {
+        FileHeader file;
+        std::atomic<std::uint32_t> generation;
+        std::atomic<std::uint32_t> ready;
+    };
+    static_assert(sizeof(SharedHeader) <= FILE_HEADER_BYTES, "The header must fit its page");
+    static constexpr int SHARED_WAIT_MS = 1000; // For the creating process to write the header
+
+    // Zeroes the allocated clusters on the threads of threadPool.
+    void zeroClusters();
+
+    static FileHeader makeHeader(std::uint64_t clusterCount, std::uint64_t netHash);
+
+    // Whether a table with this header can be read by this build evaluating with the network.
+    static bool compatible(const FileHeader& header, std::uint64_t netHash);
+
+    // FNV-1a, which unlike std::hash is the same in every build.
+    static std::uint64_t networkHash(const std::string& network) {
+        std::uint64_t hash = 0xCBF29CE484222325ULL;
+        for (unsigned char c : network) {
+            hash = (hash ^ c) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    // Data words first, so that each is 8-byte aligned, then the checks.
+    struct alignas(32) Cluster {
+        std::atomic<std::uint64_t> data[ENTRIES_PER_CLUSTER];
+        std::atomic<std::uint16_t> check[ENTRIES_PER_CLUSTER];
+        char padding[2];
+    };
+    static_assert(sizeof(Cluster) == 32, "Two clusters must fill one cache line");
+
+    // Bits 0-15 hold the move, 16-23 the depth, 24-25 the bound, 26-31 the generation,
+    // 32-47 the evaluation and 48-63 the static evaluation.
+    std::uint64_t pack(int depth, int eval, Bound bound, chess::Move bestMove,
+                       int staticEval) const {
+        return static_cast<std::uint64_t>(bestMove.move()) |
+               static_cast<std::uint64_t>(static_cast<std::uint8_t>(depth)) << 16 |
+               static_cast<std::uint64_t>(bound) << 24 |
+               static_cast<std::uint64_t>(currentGeneration()) << 26 |
+               static_cast<std::uint64_t>(static_cast<std::uint16_t>(eval)) << 32 |
+               packStaticEval(staticEval);
+    }
+
+    static std::uint64_t packStaticEval(int staticEval) {
+        if (staticEval < -INT16_MAX || staticEval > INT16_MAX) {
+            staticEval = NO_EVAL;
+        }
+        return static_cast<std::uint64_t>(static_cast<std::uint16_t>(staticEval)) << 48;
+    }
+
+    static std::uint16_t checkOf(std::uint64_t key, std::uint64_t data) {
+        return static_cast<std::uint16_t>(key ^ data ^ data >> 16 ^ data >> 32 ^ data >> 48);
+    }
+
+    static int depthOf(std::uint64_t data) { return static_cast<std::int8_t>(data >> 16); }
+    static int evalOf(std::uint64_t data) { return static_cast<std::int16_t>(data >> 32); }
+    static int staticEvalOf(std::uint64_t data) { return static_cast<std::int16_t>(data >> 48); }
+    static int generationOf(std::uint64_t data) { return (data >> 26) & (GENERATIONS - 1); }
+
+    int currentGeneration() const {
+        return generation->load(std::memory_order_relaxed) % GENERATIONS;
+    }
+
+    // Searches since the entry was written, wrapping after GENERATIONS.
+    int ageOf(std::uint64_t data) const {
+        return (currentGeneration() - generationOf(data) + GENERATIONS) % GENERATIONS;
+    }
+
+    // The top bits of the key times an odd constant, which mixes all bits of the key in.
+    Cluster& clusterOf(std::uint64_t key) const {
+        return clusters[(key * 0x9E3779B97F4A7C15ULL) >> shift];
+    }
+
+    LargePageMemory memory;
+    Cluster* clusters = nullptr;
+    std::uint64_t clusterCount = 0; // Allocated clusters, 0 before allocate()
+    std::uint64_t sizedCount = 0;   // Clusters asked for by resize()
+    int shift = 64;
+    // Searches so far, counted here or in the header of the shared segment
+    std::atomic<std::uint32_t> ownGeneration{0};
+    std::atomic<std::uint32_t>* generation = &ownGeneration;
+    std::string sharedName;
+    std::uint64_t sharedNetHash = 0;
+};
+
+extern TranspositionTable transTable;
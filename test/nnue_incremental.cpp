@@ -0,0 +1,129 @@
+#include "../src/chess.hpp"
+#include "../src/nnue.hpp"
+#include "../lib/stockfish_nnue_probe/probe.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace chess;
+
+// Compares the incrementally updated evaluation and the bitboard evaluation against the
+// from-scratch FEN evaluation on every node of a small tree below each position, including
+// null moves and unmakes. The children of every inner node are also evaluated as one batch.
+int mismatches = 0;
+int checked = 0;
+int batched = 0;
+long long evalSum = 0;
+Stockfish::Probe::Scratch scratch;
+
+void compare(NNUEBoard& board) {
+    std::uint64_t byColor[2], byType[6];
+    board.bitboards(byColor, byType);
+
+    int incremental = board.evaluate();
+    int bitboards = Stockfish::Probe::eval(byColor, byType, board.sideToMove() == Color::WHITE,
+                                           board.halfMoveClock(), scratch);
+    int fromScratch = Stockfish::Probe::eval(board.getFen().c_str());
+    checked++;
+    evalSum += fromScratch;
+
+    if (incremental != fromScratch || bitboards != fromScratch) {
+        mismatches++;
+        std::cout << "Mismatch at " << board.getFen() << ": incremental " << incremental
+                  << " bitboards " << bitboards << " fen " << fromScratch << std::endl;
+    }
+}
+
+void compareChildren(NNUEBoard& board, const Movelist& moves) {
+    std::vector<Stockfish::Probe::Bitboards> children(moves.size());
+    std::vector<int> fromScratch(moves.size());
+
+    for (int i = 0; i < moves.size(); i++) {
+        board.makeMove(moves[i]);
+        auto& child = children[i];
+        board.bitboards(child.byColor, child.byType);
+        child.side = board.sideToMove() == Color::WHITE;
+        child.rule50 = board.halfMoveClock();
+        fromScratch[i] = Stockfish::Probe::eval(board.getFen().c_str());
+        board.unmakeMove(moves[i]);
+    }
+
+    std::vector<int> evals(moves.size());
+    Stockfish::Probe::eval(children.data(), moves.size(), evals.data(), scratch);
+    batched += moves.size();
+
+    for (int i = 0; i < moves.size(); i++) {
+        if (evals[i] != fromScratch[i]) {
+            mismatches++;
+            std::cout << "Batch mismatch after " << uci::moveToUci(moves[i]) << " at "
+                      << board.getFen() << ": batched " << evals[i] << " fen " << fromScratch[i]
+                      << std::endl;
+        }
+    }
+}
+
+void walk(NNUEBoard& board, int depth, std::mt19937& rng) {
+    compare(board);
+
+    if (depth == 0) {
+        return;
+    }
+
+    Movelist moves;
+    movegen::legalmoves(moves, board);
+
+    if (moves.empty()) {
+        return;
+    }
+    compareChildren(board, moves);
+
+    // A few random children, plus every capture and promotion so that all kinds of dirty
+    // pieces are covered.
+    for (int i = 0; i < moves.size(); i++) {
+        Move move = moves[i];
+        bool special = board.isCapture(move) || move.typeOf() != Move::NORMAL;
+        if (!special && rng() % 4 != 0) {
+            continue;
+        }
+        board.makeMove(move);
+        walk(board, depth - 1, rng);
+        board.unmakeMove(move);
+        compare(board);
+    }
+
+    if (!board.inCheck()) {
+        board.makeNullMove();
+        walk(board, depth - 1, rng);
+        board.unmakeNullMove();
+    }
+}
+
+int main() {
+    // With NNUE_BLOB_DIR the nets are mapped from, or first written to, pre-decoded blobs
+    Stockfish::Probe::init("nn-b1a57edbea57.nnue", "nn-b1a57edbea57.nnue", std::getenv("NNUE_BLOB_DIR"));
+    std::cout << "NNUE kernels: " << Stockfish::Probe::simd() << std::endl;
+    Stockfish::Probe::Evaluator evaluator;
+    std::mt19937 rng(2024);
+
+    std::vector<std::string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r2q1r1k/1b3p2/p2Ppn2/1p4Q1/8/3B4/PPP2PPP/R4RK1 w - - 1 22",
+        "8/2p2k1p/3p4/3P3q/1p4R1/P1B2P2/4r3/Q5K1 w - - 1 42",
+        "4b3/4bpk1/4p3/1p2P1P1/4NQ2/p5K1/3R4/6q1 w - - 2 46",
+        "rnbqkb1r/pp1p1pPp/8/2p1pP2/1P1P4/3P3P/P1P1P3/RNBQKBNR w KQkq e6 0 1",
+        "8/8/3k4/8/8/8/3K4/4R3 w - - 0 1",
+    };
+
+    for (const auto& fen : fens) {
+        NNUEBoard board(Board(fen), evaluator);
+        walk(board, 3, rng);
+    }
+
+    // The sum lets runs with different kernels (NNUE_SIMD) be compared with each other.
+    std::cout << "Checked " << checked << " positions and " << batched << " batched, "
+              << mismatches << " mismatches, eval sum " << evalSum << "." << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
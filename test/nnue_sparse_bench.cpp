@@ -0,0 +1,70 @@
+#include "../src/chess.hpp"
+#include "../lib/stockfish_nnue_probe/probe.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace chess;
+
+// Times the first hidden layer of the big net, sparse against dense, on the positions two
+// plies below a few fixed openings, middlegames and endgames. The set is the same on
+// every run, so ratios can be compared between kernels (NNUE_SIMD) and machines.
+void collect(Board& board, int depth, std::vector<std::string>& fens) {
+    fens.push_back(board.getFen());
+
+    if (depth == 0) {
+        return;
+    }
+
+    Movelist moves;
+    movegen::legalmoves(moves, board);
+
+    for (const auto& move : moves) {
+        board.makeMove(move);
+        collect(board, depth - 1, fens);
+        board.unmakeMove(move);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    Stockfish::Probe::init("nn-b1a57edbea57.nnue", "nn-b1a57edbea57.nnue", std::getenv("NNUE_BLOB_DIR"));
+
+    std::vector<std::string> roots = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r2q1r1k/1b3p2/p2Ppn2/1p4Q1/8/3B4/PPP2PPP/R4RK1 w - - 1 22",
+        "8/2p2k1p/3p4/3P3q/1p4R1/P1B2P2/4r3/Q5K1 w - - 1 42",
+        "4b3/4bpk1/4p3/1p2P1P1/4NQ2/p5K1/3R4/6q1 w - - 2 46",
+        "8/8/3k4/8/8/8/3K4/4R3 w - - 0 1",
+    };
+
+    std::vector<std::string> fens;
+    for (const auto& fen : roots) {
+        Board board(fen);
+        collect(board, 2, fens);
+    }
+
+    std::vector<const char*> pointers;
+    for (const auto& fen : fens) {
+        pointers.push_back(fen.c_str());
+    }
+
+    auto result = Stockfish::Probe::bench_first_layer(pointers.data(), pointers.size(), iterations);
+
+    std::printf("NNUE kernels: %s\n", Stockfish::Probe::simd());
+    std::printf("Positions: %zu, %d iterations\n", fens.size(), iterations);
+    std::printf("Nonzero input blocks: %.1f%%\n", 100.0 * result.nnzRatio);
+    std::printf("Sparse: %.1f ns/propagate\n", result.sparseNs);
+    std::printf("Dense:  %.1f ns/propagate (%.2fx the sparse time)\n", result.denseNs,
+                result.denseNs / result.sparseNs);
+
+    if (!result.identical) {
+        std::printf("Sparse and dense outputs differ\n");
+        return 1;
+    }
+    return 0;
+}